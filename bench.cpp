@@ -0,0 +1,602 @@
+#include "./src/chess_board/chess_board.h"
+#include "./src/evaluation/evaluation.h"
+#include "./src/log/log.h"
+#include "./src/magics/magics.h"
+#include "./src/nnue/nnue.h"
+#include "./src/perft/perft.h"
+#include "./src/search/search.h"
+#include "./src/thread_pool/thread_pool.h"
+#include "./src/transposition_table/transposition_table.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <vector>
+
+static double secondsSince(std::chrono::steady_clock::time_point start) {
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count();
+}
+
+/**
+ * Looks up rook and bishop attacks on sample boards with one backend.
+ *
+ * @return Checksum of the attacks, so the lookups are not optimized away
+ */
+template <SlidingBackend Backend>
+static uint64_t timeLookups(const std::vector<uint8_t> &squares,
+                            const std::vector<uint64_t> &occupancies,
+                            uint64_t lookups) {
+  uint64_t checksum = 0;
+  size_t samples = squares.size();
+  for (uint64_t i = 0; i < lookups; i++) {
+    size_t sample = i & (samples - 1);
+    checksum ^= getRookAttacks<Backend>(squares[sample], occupancies[sample]);
+    checksum ^= getBishopAttacks<Backend>(squares[sample], occupancies[sample]);
+  }
+  return checksum;
+}
+
+/**
+ * Times rook + bishop lookups on random occupancies for each backend, then
+ * rebuilds the tables for the build's backend.
+ */
+static int benchSliders(uint64_t lookups) {
+  // Sparse random boards (~1/8 of squares occupied) with random squares
+  const int SAMPLES = 4096;
+  std::mt19937_64 rng(20240817);
+  std::vector<uint64_t> occupancies(SAMPLES);
+  std::vector<uint8_t> squares(SAMPLES);
+  for (int i = 0; i < SAMPLES; i++) {
+    occupancies[i] = rng() & rng() & rng();
+    squares[i] = rng() % 64;
+  }
+
+  SlidingBackend backends[] = {SlidingBackend::Magic, SlidingBackend::Pext};
+  for (SlidingBackend requested : backends) {
+    if (requested == SlidingBackend::Pext && !cpuHasFastPext()) {
+      std::cout << "pext: not available on this CPU\n";
+      continue;
+    }
+
+    initMagics(requested);
+    SlidingBackend backend = getSlidingBackend();
+    if (backend != requested) {
+      std::cout << slidingBackendName(requested)
+                << ": not available in this build\n";
+      continue;
+    }
+    if (!verifyMagics()) {
+      return 1;
+    }
+
+    uint64_t checksum = 0;
+    auto start = std::chrono::steady_clock::now();
+    if (backend == SlidingBackend::Pext) {
+      checksum = timeLookups<SlidingBackend::Pext>(squares, occupancies,
+                                                   lookups);
+    } else {
+      checksum = timeLookups<SlidingBackend::Magic>(squares, occupancies,
+                                                    lookups);
+    }
+    double seconds = secondsSince(start);
+
+    std::cout << slidingBackendName(backend) << ": "
+              << seconds * 1e9 / (2 * lookups) << " ns/lookup, "
+              << (uint64_t)(2 * lookups / seconds) << " lookups/second"
+              << " (checksum " << std::hex << checksum << std::dec << ")\n";
+  }
+
+  initMagics();
+  return 0;
+}
+
+/**
+ * Searches each perft position to a fixed depth with a fresh hash table and
+ * reports the total node count and speed. The node count doubles as a
+ * signature: it changes whenever search behaviour changes.
+ */
+static int benchSearch(int depth) {
+  ChessBoard board;
+  TranspositionTable tt;
+  Search search(tt);
+
+  SearchLimits limits;
+  limits.depth = depth;
+
+  uint64_t totalNodes = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (const PerftPosition &position : PERFT_POSITIONS) {
+    board.loadFen(position.fen);
+    tt.clear();
+    Move best = search.think(board, limits);
+    totalNodes += search.getNodes();
+    std::cout << position.name << ": " << moveToString(best) << " ("
+              << search.getNodes() << " nodes)\n";
+  }
+  double seconds = secondsSince(start);
+
+  const PawnTable &pawns = search.getPawnTable();
+  double pawnHits = 100.0 * pawns.getHits() / pawns.getProbes();
+  std::cout << "\nNodes: " << totalNodes << "\nTime: " << seconds
+            << " s\nNodes/second: " << (uint64_t)(totalNodes / seconds)
+            << "\nPawn hash hits: " << pawnHits << "%\n";
+  return 0;
+}
+
+/**
+ * Measures Lazy SMP scaling: the perft positions are searched to a fixed
+ * depth with 1, 2, 4, ... threads. Time to depth and nodes/second are
+ * compared with the single-threaded run.
+ */
+static int benchSmp(int depth, int maxThreads) {
+  ChessBoard board;
+  TranspositionTable tt;
+  tt.resize(64);
+  ThreadPool pool(tt);
+
+  SearchLimits limits;
+  limits.depth = depth;
+
+  double baseSeconds = 0;
+  double baseNps = 0;
+  for (int threads = 1; threads <= maxThreads; threads *= 2) {
+    pool.setThreads(threads);
+
+    uint64_t totalNodes = 0;
+    double seconds = 0;
+    for (const PerftPosition &position : PERFT_POSITIONS) {
+      board.loadFen(position.fen);
+      tt.clear(threads);
+
+      auto start = std::chrono::steady_clock::now();
+      pool.think(board, limits);
+      seconds += secondsSince(start);
+      totalNodes += pool.getNodes();
+    }
+
+    double nps = totalNodes / seconds;
+    if (threads == 1) {
+      baseSeconds = seconds;
+      baseNps = nps;
+    }
+
+    std::cout << "threads " << threads << ": time " << seconds
+              << " s (speedup " << baseSeconds / seconds << "), nodes "
+              << totalNodes << ", nodes/second " << (uint64_t)nps
+              << " (x" << nps / baseNps << ")\n";
+  }
+
+  std::cout << "Hardware threads: " << std::thread::hardware_concurrency()
+            << "\n";
+  return 0;
+}
+
+/**
+ * Checks the incremental evaluation terms against a full recompute: random
+ * games are played from each perft position and taken back again, comparing
+ * after every makeMove and unmakeMove.
+ */
+static int benchEval(int games, int plies) {
+  ChessBoard board;
+  BoardHistory game;
+  std::mt19937_64 rng(20241017);
+  uint64_t checks = 0;
+  uint64_t mismatches = 0;
+
+  auto check = [&](const char *when) {
+    checks++;
+    if (board.getPsqtScore() == board.computePsqtScore() &&
+        board.getPhase() == board.computePhase() &&
+        board.getPawnKey() == board.computePawnKey()) {
+      return;
+    }
+    if (mismatches++ < 10) {
+      std::cout << "Mismatch after " << when << " "
+                << moveToString(game.getLastMove()) << "\n";
+      board.display();
+    }
+  };
+
+  for (const PerftPosition &position : PERFT_POSITIONS) {
+    for (int round = 0; round < games; round++) {
+      board.loadFen(position.fen);
+      game.clear();
+      int played = 0;
+      MoveList moves;
+      for (; played < plies; played++) {
+        board.generateMoves(moves);
+        if (moves.empty()) {
+          break;
+        }
+        game.makeMove(board, moves[rng() % moves.size()]);
+        check("makeMove");
+      }
+      for (; played > 0; played--) {
+        game.unmakeMove(board);
+        check("unmakeMove");
+      }
+    }
+  }
+
+  std::cout << "Checked " << checks << " positions, " << mismatches
+            << " mismatches\n";
+  return mismatches ? 1 : 0;
+}
+
+/// FENs loadFen must reject, each breaking one rule
+static const char *const INVALID_FENS[] = {
+    "4k3/8/8/3PN3/8/8/8/4K3 w - e6 0 1",          // en passant takes a knight
+    "4k3/8/8/3P4/8/8/8/4K3 w - e6 0 1",           // en passant takes nothing
+    "4k3/8/4n3/3Pp3/8/8/8/4K3 w - e6 0 1",        // en passant target taken
+    "4k3/4n3/8/3Pp3/8/8/8/4K3 w - e6 0 1",        // pawn start square taken
+    "4k3/8/8/8/3pP3/8/8/4K3 w - e3 0 1",          // ep rank for wrong side
+    "4k3/8/8/8/8/8/8/4K2r b - - 0 1",             // side not to move in check
+    "4k3/4Q3/8/8/8/8/8/4K3 w - - 0 1",            // side not to move in check
+    "4k3/8/8/8/8/7Q/QQQQQQQQ/QQQQQQQK w - - 0 1", // 17 white pieces
+    "4k2P/8/8/8/8/8/8/4K3 w - - 0 1",             // pawn on rank 8
+    "4k3/8/8/8/8/8/8/3KK3 w - - 0 1",             // two white kings
+};
+
+/// FENs loadFen must accept, next to the rejected ones above
+static const char *const VALID_FENS[] = {
+    "4k3/8/8/3Pp3/8/8/8/4K3 w - e6 0 1",
+    "4k3/8/8/8/3pP3/8/8/4K3 b - e3 0 1",
+    "4k3/8/8/8/8/8/8/4K2r w - - 0 1",
+};
+
+/**
+ * Round-trips positions from random games through writeFen and loadFen,
+ * checking that nothing is lost, then times both directions. Reports the
+ * best of several passes, with positions that miss the cache and with a
+ * few that stay in it.
+ */
+static int benchFen(int games, int plies) {
+  ChessBoard board;
+  ChessBoard loaded;
+  std::mt19937_64 rng(20241017);
+  std::vector<std::string> fens;
+  uint64_t mismatches = 0;
+  char buffer[FEN_BUFFER_SIZE];
+
+  for (const PerftPosition &position : PERFT_POSITIONS) {
+    for (int game = 0; game < games; game++) {
+      board.loadFen(position.fen);
+      MoveList moves;
+      BoardState state;
+      for (int played = 0; played < plies; played++) {
+        board.generateMoves(moves);
+        if (moves.empty()) {
+          break;
+        }
+        board.makeMove(moves[rng() % moves.size()], state);
+
+        board.writeFen(buffer);
+        if (!loaded.loadFen(buffer) ||
+            loaded.getZobristKey() != board.getZobristKey() ||
+            loaded.getPsqtScore() != board.getPsqtScore() ||
+            loaded.getPawnKey() != board.getPawnKey() ||
+            loaded.getFen() != buffer) {
+          if (mismatches++ < 10) {
+            std::cout << "Mismatch: " << buffer << " -> " << loaded.getFen()
+                      << "\n";
+          }
+        }
+        fens.push_back(buffer);
+      }
+    }
+  }
+  std::cout << "Checked " << fens.size() << " positions, " << mismatches
+            << " mismatches\n";
+
+  // A rejected FEN must leave the board as it was
+  uint64_t rejected = 0;
+  for (const char *fen : INVALID_FENS) {
+    loaded.loadFen(STARTING_FEN);
+    if (loaded.loadFen(fen) || loaded.getFen() != STARTING_FEN) {
+      std::cout << "Accepted invalid FEN: " << fen << "\n";
+      mismatches++;
+    } else {
+      rejected++;
+    }
+  }
+  for (const char *fen : VALID_FENS) {
+    if (!loaded.loadFen(fen)) {
+      std::cout << "Rejected valid FEN: " << fen << "\n";
+      mismatches++;
+    }
+  }
+  std::cout << "Rejected " << rejected << " of " << std::size(INVALID_FENS)
+            << " invalid FENs\n";
+
+  // Timings on a shared machine swing by up to 2x between runs, so each
+  // figure is the best of several passes. The game positions are spread
+  // over a few MB of strings; the perft positions stay in cache.
+  std::vector<std::string> hot;
+  std::vector<ChessBoard> hotBoards;
+  for (const PerftPosition &position : PERFT_POSITIONS) {
+    hot.push_back(position.fen);
+    hotBoards.emplace_back(position.fen);
+  }
+
+  const int PASSES = 5;
+  uint64_t checksum = 0;
+  auto bestOf = [&](auto &&pass, double calls) {
+    double best = 1e30;
+    for (int i = 0; i < PASSES; i++) {
+      auto start = std::chrono::steady_clock::now();
+      pass();
+      best = std::min(best, secondsSince(start));
+    }
+    return best * 1e9 / calls;
+  };
+
+  double coldLoad = bestOf(
+      [&] {
+        for (const std::string &fen : fens) {
+          loaded.loadFen(fen);
+          checksum ^= loaded.getZobristKey();
+        }
+      },
+      fens.size());
+
+  const int HOT_ROUNDS = 20000;
+  double hotLoad = bestOf(
+      [&] {
+        for (int round = 0; round < HOT_ROUNDS; round++) {
+          for (const std::string &fen : hot) {
+            loaded.loadFen(fen);
+            checksum ^= loaded.getZobristKey();
+          }
+        }
+      },
+      double(HOT_ROUNDS) * hot.size());
+
+  double write = bestOf(
+      [&] {
+        for (int round = 0; round < HOT_ROUNDS; round++) {
+          for (const ChessBoard &hotBoard : hotBoards) {
+            checksum += hotBoard.writeFen(buffer) + buffer[round & 15];
+          }
+        }
+      },
+      double(HOT_ROUNDS) * hotBoards.size());
+
+  std::cout << "loadFen: " << coldLoad << " ns/position (game positions), "
+            << hotLoad << " ns/position (perft positions, cached)\n"
+            << "writeFen: " << write << " ns/position (checksum " << std::hex
+            << checksum << std::dec << ")\n";
+  return mismatches ? 1 : 0;
+}
+
+/**
+ * Writes a network of small random weights, which exercises every kernel
+ * without needing a trained net.
+ */
+static bool writeRandomNetwork(const std::string &path) {
+  std::mt19937 rng(20241017);
+  auto random = [&rng](int low, int high) {
+    return std::uniform_int_distribution<int>(low, high)(rng);
+  };
+
+  std::vector<char> bytes;
+  auto put = [&bytes](const void *value, size_t size) {
+    const char *first = static_cast<const char *>(value);
+    bytes.insert(bytes.end(), first, first + size);
+  };
+  auto putMany = [&](int count, size_t size, int low, int high) {
+    for (int i = 0; i < count; i++) {
+      int32_t value = random(low, high);
+      put(&value, size); // little endian: the low bytes come first
+    }
+  };
+
+  NnueHeader header = {{'N', 'N', 'U', 'E'}, NNUE_VERSION, NNUE_FEATURES,
+                       NNUE_HIDDEN, {}};
+  put(&header, sizeof(header));
+  putMany(NNUE_FEATURES * NNUE_HIDDEN, 2, -16, 16); // feature weights
+  putMany(NNUE_HIDDEN, 2, 0, 64);                   // feature biases
+  putMany(NNUE_L1 * 2 * NNUE_HIDDEN, 1, -8, 8);     // L1 weights
+  putMany(NNUE_L1, 4, -256, 256);                   // L1 biases
+  putMany(NNUE_L2 * NNUE_L1, 1, -32, 32);           // L2 weights
+  putMany(NNUE_L2, 4, -256, 256);                   // L2 biases
+  putMany(NNUE_L2, 1, -64, 64);                     // output weights
+  putMany(1, 4, -100, 100);                         // output bias
+
+  std::ofstream file(path, std::ios::binary);
+  file.write(bytes.data(), bytes.size());
+  return bool(file);
+}
+
+/**
+ * Makes and unmakes every move of a perft tree, optionally keeping
+ * accumulators up to date and evaluating each node with them.
+ *
+ * @param nnue Accumulators to update, or nullptr
+ * @return Number of nodes visited
+ */
+static uint64_t walkTree(ChessBoard &board, int depth, AccumulatorStack *nnue,
+                         bool evaluateNodes, int64_t &checksum) {
+  if (evaluateNodes) {
+    checksum += nnue->evaluate(board);
+  }
+  if (depth == 0) {
+    return 1;
+  }
+
+  uint64_t nodes = 1;
+  MoveList moves;
+  board.generateMoves(moves);
+  BoardState state;
+  for (const Move &move : moves) {
+    board.makeMove(move, state);
+    if (nnue) {
+      nnue->push(board, state);
+    }
+    nodes += walkTree(board, depth - 1, nnue, evaluateNodes, checksum);
+    if (nnue) {
+      nnue->pop();
+    }
+    board.unmakeMove(state);
+  }
+  return nodes;
+}
+
+/**
+ * Checks and times network evaluation. Random games are played with each
+ * SIMD backend; after every makeMove and unmakeMove the incremental
+ * accumulator must match a refresh, and evaluations must agree across
+ * backends. Then a perft tree is walked with and without the network.
+ *
+ * @param path Weight file; a random network is written there if missing
+ */
+static int benchNnue(const std::string &path) {
+  Network network;
+  if (!network.load(path)) {
+    if (!writeRandomNetwork(path) || !network.load(path)) {
+      std::cout << "Cannot load or write " << path << "\n";
+      return 1;
+    }
+    std::cout << "Wrote random network to " << path << "\n";
+  }
+
+  SimdBackend best = cpuSimdBackend();
+  std::vector<int> reference;
+  uint64_t mismatches = 0;
+  for (int b = 0; b <= int(best); b++) {
+    setSimdBackend(SimdBackend(b));
+    ChessBoard board;
+    BoardHistory game;
+    AccumulatorStack nnue(&network);
+    AccumulatorStack fresh(&network);
+    std::mt19937_64 rng(20241017);
+    size_t visited = 0;
+
+    auto check = [&]() {
+      fresh.reset(board);
+      int score = nnue.evaluate(board);
+      if (std::memcmp(&fresh.top(), &nnue.top(), sizeof(Accumulator)) != 0) {
+        mismatches++;
+      }
+      if (b == 0) {
+        reference.push_back(score);
+      } else if (reference[visited] != score) {
+        mismatches++;
+      }
+      visited++;
+    };
+
+    for (const PerftPosition &position : PERFT_POSITIONS) {
+      for (int round = 0; round < 20; round++) {
+        board.loadFen(position.fen);
+        game.clear();
+        nnue.reset(board);
+        int played = 0;
+        MoveList moves;
+        for (; played < 100; played++) {
+          board.generateMoves(moves);
+          if (moves.empty()) {
+            break;
+          }
+          game.makeMove(board, moves[rng() % moves.size()]);
+          nnue.push(board, game.back());
+          check();
+        }
+        for (; played > 0; played--) {
+          game.unmakeMove(board);
+          nnue.pop();
+          check();
+        }
+      }
+    }
+    std::cout << simdBackendName(SimdBackend(b)) << ": checked " << visited
+              << " positions\n";
+  }
+  std::cout << mismatches << " mismatches\n";
+  if (mismatches) {
+    return 1;
+  }
+
+  // Speed over a perft tree: make/unmake alone, with the accumulator kept
+  // up to date, and with every node evaluated. A random network makes
+  // search trees meaningless, so no search is timed here.
+  const int WALK_DEPTH = 4;
+  ChessBoard board;
+  board.loadFen(PERFT_POSITIONS[1].fen);
+  AccumulatorStack nnue(&network);
+  for (int b = -1; b <= int(best); b++) {
+    if (b >= 0) {
+      setSimdBackend(SimdBackend(b));
+      nnue.reset(board);
+    }
+    for (bool evaluateNodes : {false, true}) {
+      if (evaluateNodes && b < 0) {
+        continue;
+      }
+      int64_t checksum = 0;
+      auto start = std::chrono::steady_clock::now();
+      uint64_t nodes = walkTree(board, WALK_DEPTH, b < 0 ? nullptr : &nnue,
+                                evaluateNodes, checksum);
+      double seconds = secondsSince(start);
+      std::cout << (b < 0 ? "no network" : simdBackendName(SimdBackend(b)))
+                << (evaluateNodes ? " + evaluate" : "") << ": "
+                << seconds * 1e9 / nodes << " ns/node\n";
+    }
+  }
+
+  setSimdBackend(best);
+  return 0;
+}
+
+static void usage() {
+  std::cout << "Usage:\n"
+            << "  bench sliders [iterations]   magic vs pext attack lookups\n"
+            << "  bench search [depth]         fixed-depth search of the "
+               "perft positions\n"
+            << "  bench smp [depth] [threads]  search scaling at 1, 2, 4, ... "
+               "threads\n"
+            << "  bench eval [games] [plies]   incremental evaluation "
+               "self-check\n"
+            << "  bench fen [games] [plies]    FEN round trip and speed\n"
+            << "  bench nnue [file]            network self-check and "
+               "speed\n";
+}
+
+int main(int argc, char **argv) {
+  // Self-checks report their failures through the library log
+  setLogHandler(logToStderr, LogLevel::Warning);
+
+  if (argc < 2 || std::strcmp(argv[1], "sliders") == 0) {
+    uint64_t iterations = argc > 2 ? std::atoll(argv[2]) : 50000000;
+    return benchSliders(iterations);
+  }
+  if (std::strcmp(argv[1], "search") == 0) {
+    return benchSearch(argc > 2 ? std::atoi(argv[2]) : 6);
+  }
+  if (std::strcmp(argv[1], "smp") == 0) {
+    int depth = argc > 2 ? std::atoi(argv[2]) : 7;
+    int threads = argc > 3 ? std::atoi(argv[3]) : 16;
+    return benchSmp(depth, threads);
+  }
+  if (std::strcmp(argv[1], "eval") == 0) {
+    int games = argc > 2 ? std::atoi(argv[2]) : 200;
+    int plies = argc > 3 ? std::atoi(argv[3]) : 200;
+    return benchEval(games, plies);
+  }
+  if (std::strcmp(argv[1], "fen") == 0) {
+    int games = argc > 2 ? std::atoi(argv[2]) : 50;
+    int plies = argc > 3 ? std::atoi(argv[3]) : 200;
+    return benchFen(games, plies);
+  }
+  if (std::strcmp(argv[1], "nnue") == 0) {
+    std::string path = argc > 2 ? argv[2] : "random.nnue";
+    return benchNnue(path);
+  }
+
+  usage();
+  return 1;
+}
@@ -1,9 +1,12 @@
 #include "./src/chess_board/chess_board.h"
+#include "./src/log/log.h"
 #include "./src/magics/magics.h"
 #include <iostream>
 
 int main() {
+  setLogHandler(logToStderr, LogLevel::Warning);
   ChessBoard board = ChessBoard();
+  BoardHistory game;
   board.display();
 
   while (true) {
@@ -24,17 +27,22 @@ int main() {
     }
 
     Move move = Move{(uint8_t)from, (uint8_t)to};
-    if (board.makeMove(move)) {
-      if (board.isCheckmate()) {
-        std::cout << "Checkmate! " << (board.sideToMove ? "White" : "Black")
-                  << " wins!\n";
-        break;
-      } else if (board.isStalemate()) {
-        std::cout << "Game drawn by stalemate!\n";
-        break;
-      }
-      board.display();
+    MoveError error = board.validateMove(move);
+    if (error != MoveError::None) {
+      std::cout << "Illegal move: " << moveErrorName(error) << "\n";
+      continue;
+    }
+    game.makeMove(board, move);
+
+    if (board.isCheckmate()) {
+      std::cout << "Checkmate! " << (board.sideToMove ? "White" : "Black")
+                << " wins!\n";
+      break;
+    } else if (board.isStalemate()) {
+      std::cout << "Game drawn by stalemate!\n";
+      break;
     }
+    board.display();
   }
 
   // testing
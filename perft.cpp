@@ -0,0 +1,159 @@
+#include "./src/chess_board/chess_board.h"
+#include "./src/magics/magics.h"
+#include "./src/perft/perft.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+static const char *START_FEN =
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+static double secondsSince(std::chrono::steady_clock::time_point start) {
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count();
+}
+
+static void printSpeed(uint64_t nodes, double seconds) {
+  std::cout << "Time: " << seconds << " s\n";
+  std::cout << "Nodes/second: "
+            << (seconds > 0 ? (uint64_t)(nodes / seconds) : nodes) << "\n";
+}
+
+/**
+ * Command line options shared by all modes.
+ */
+struct PerftOptions {
+  int threads = 1;
+  std::unique_ptr<PerftHash> hash; /// Set by -H, nullptr means no hash
+};
+
+static std::vector<PerftDivideEntry>
+divide(ChessBoard &board, int depth, const PerftOptions &options) {
+  if (options.threads > 1 || options.hash) {
+    return perftDivideParallel(board, depth, options.threads,
+                               options.hash.get());
+  }
+  return perftDivide(board, depth);
+}
+
+static int runDivide(ChessBoard &board, int depth,
+                     const PerftOptions &options) {
+  auto start = std::chrono::steady_clock::now();
+  std::vector<PerftDivideEntry> entries = divide(board, depth, options);
+  double seconds = secondsSince(start);
+
+  uint64_t total = 0;
+  for (const PerftDivideEntry &entry : entries) {
+    std::cout << moveToString(entry.move) << ": " << entry.nodes << "\n";
+    total += entry.nodes;
+  }
+
+  std::cout << "\nMoves: " << entries.size() << "\n";
+  std::cout << "Nodes: " << total << "\n";
+  printSpeed(total, seconds);
+  return 0;
+}
+
+static int runSuite(ChessBoard &board, int maxDepth,
+                    const PerftOptions &options) {
+  uint64_t totalNodes = 0;
+  double totalSeconds = 0;
+  int failures = 0;
+
+  bool magicsOk = verifyMagics();
+  failures += !magicsOk;
+  std::cout << "Sliding attack tables: " << (magicsOk ? "ok" : "FAIL")
+            << "\n\n";
+
+  for (const PerftPosition &position : PERFT_POSITIONS) {
+    board.loadFen(position.fen);
+    std::cout << position.name << " (" << position.fen << ")\n";
+
+    int depthLimit = std::min<int>(maxDepth, position.expected.size());
+    for (int depth = 1; depth <= depthLimit; depth++) {
+      auto start = std::chrono::steady_clock::now();
+      uint64_t nodes = 0;
+      for (const PerftDivideEntry &entry : divide(board, depth, options)) {
+        nodes += entry.nodes;
+      }
+      double seconds = secondsSince(start);
+
+      uint64_t expected = position.expected[depth - 1];
+      bool ok = nodes == expected;
+      failures += !ok;
+      totalNodes += nodes;
+      totalSeconds += seconds;
+
+      std::cout << "  depth " << depth << ": " << nodes;
+      if (!ok) {
+        std::cout << " (expected " << expected << ")";
+      }
+      std::cout << (ok ? "  ok" : "  FAIL") << "  " << seconds << " s\n";
+    }
+  }
+
+  std::cout << "\nNodes: " << totalNodes << "\n";
+  printSpeed(totalNodes, totalSeconds);
+  std::cout << (failures ? "FAILED: " : "All passed")
+            << (failures ? std::to_string(failures) + " mismatches" : "")
+            << std::endl;
+
+  return failures ? 1 : 0;
+}
+
+static void usage() {
+  std::cout << "Usage:\n"
+            << "  perft [options] suite [maxDepth]   check standard positions\n"
+            << "  perft [options] <depth> [fen]      divide from startpos or "
+               "FEN\n"
+            << "Options:\n"
+            << "  -t <threads>   split the tree over several threads\n"
+            << "  -H <mb>        cache subtree counts in a shared hash\n";
+}
+
+int main(int argc, char **argv) {
+  ChessBoard board;
+  PerftOptions options;
+
+  // Options come first; whatever follows is the mode and its arguments
+  std::vector<std::string> args;
+  for (int i = 1; i < argc; i++) {
+    bool hasValue = i + 1 < argc;
+    if (std::strcmp(argv[i], "-t") == 0 && hasValue) {
+      options.threads = std::max(1, std::atoi(argv[++i]));
+    } else if (std::strcmp(argv[i], "-H") == 0 && hasValue) {
+      options.hash = std::make_unique<PerftHash>(std::atoi(argv[++i]));
+    } else {
+      args.push_back(argv[i]);
+    }
+  }
+
+  if (args.empty() || args[0] == "suite") {
+    int maxDepth = args.size() > 1 ? std::atoi(args[1].c_str()) : 4;
+    return runSuite(board, maxDepth, options);
+  }
+
+  int depth = std::atoi(args[0].c_str());
+  if (depth < 1) {
+    usage();
+    return 1;
+  }
+
+  // Remaining arguments form the FEN, so it may be passed unquoted
+  std::string fen;
+  for (size_t i = 1; i < args.size(); i++) {
+    fen += (i > 1 ? " " : "") + args[i];
+  }
+  if (!board.loadFen(fen.empty() ? START_FEN : fen)) {
+    std::cout << "Invalid FEN: " << fen << "\n";
+    return 1;
+  }
+
+  return runDivide(board, depth, options);
+}
@@ -0,0 +1,182 @@
+#ifndef ATTACKS_H
+#define ATTACKS_H
+
+#include <array>
+#include <cstdint>
+
+/**
+ * Pre-computed attack lookup tables for the non-sliding pieces.
+ *
+ * The tables are generated at compile time and shared by every ChessBoard,
+ * so boards carry no per-instance copies and need no initialization.
+ */
+
+/// Files and ranks used to mask shifted bitboards
+inline constexpr uint64_t FILE_A = 0x0101010101010101ULL;
+inline constexpr uint64_t FILE_H = 0x8080808080808080ULL;
+inline constexpr uint64_t RANK_1 = 0x00000000000000FFULL;
+inline constexpr uint64_t RANK_4 = 0x00000000FF000000ULL;
+inline constexpr uint64_t RANK_5 = 0x000000FF00000000ULL;
+inline constexpr uint64_t RANK_8 = 0xFF00000000000000ULL;
+
+/**
+ * Builds king movement patterns for each square.
+ */
+constexpr std::array<uint64_t, 64> generateKingAttacks() {
+  std::array<uint64_t, 64> table{};
+  for (int sq = 0; sq < 64; sq++) {
+    uint64_t attacks = 0;
+    int rank = sq / 8;
+    int file = sq % 8;
+
+    // Up
+    if (rank < 7) {
+      attacks |= 1ULL << (sq + 8); // Up
+      if (file > 0)
+        attacks |= 1ULL << (sq + 7); // Up-left
+      if (file < 7)
+        attacks |= 1ULL << (sq + 9); // Up-right
+    }
+
+    // Same rank
+    if (file > 0)
+      attacks |= 1ULL << (sq - 1); // Left
+    if (file < 7)
+      attacks |= 1ULL << (sq + 1); // Right
+
+    // Down
+    if (rank > 0) {
+      attacks |= 1ULL << (sq - 8); // Down
+      if (file > 0)
+        attacks |= 1ULL << (sq - 9); // Down-left
+      if (file < 7)
+        attacks |= 1ULL << (sq - 7); // Down-right
+    }
+
+    table[sq] = attacks;
+  }
+  return table;
+}
+
+/**
+ * Builds knight movement patterns for each square.
+ */
+constexpr std::array<uint64_t, 64> generateKnightAttacks() {
+  std::array<uint64_t, 64> table{};
+  for (int sq = 0; sq < 64; sq++) {
+    uint64_t attacks = 0;
+    int rank = sq / 8;
+    int file = sq % 8;
+
+    if (rank < 6 && file < 7)
+      attacks |= 1ULL << (sq + 17);
+    if (rank < 6 && file > 0)
+      attacks |= 1ULL << (sq + 15);
+    if (rank < 7 && file < 6)
+      attacks |= 1ULL << (sq + 10);
+    if (rank > 0 && file < 6)
+      attacks |= 1ULL << (sq - 6);
+    if (rank > 1 && file < 7)
+      attacks |= 1ULL << (sq - 15);
+    if (rank > 1 && file > 0)
+      attacks |= 1ULL << (sq - 17);
+    if (rank < 7 && file > 1)
+      attacks |= 1ULL << (sq + 6);
+    if (rank > 0 && file > 1)
+      attacks |= 1ULL << (sq - 10);
+
+    table[sq] = attacks;
+  }
+  return table;
+}
+
+/**
+ * Builds pawn capture patterns for each color (0 = white, 1 = black).
+ */
+constexpr std::array<std::array<uint64_t, 64>, 2> generatePawnAttacks() {
+  std::array<std::array<uint64_t, 64>, 2> table{};
+  for (int sq = 0; sq < 64; sq++) {
+    uint64_t white_attacks = 0;
+    uint64_t black_attacks = 0;
+    int rank = sq / 8;
+    int file = sq % 8;
+
+    if (rank < 7) {
+      if (file > 0)
+        white_attacks |= 1ULL << (sq + 7);
+      if (file < 7)
+        white_attacks |= 1ULL << (sq + 9);
+    }
+
+    if (rank > 0) {
+      if (file > 0)
+        black_attacks |= 1ULL << (sq - 9);
+      if (file < 7)
+        black_attacks |= 1ULL << (sq - 7);
+    }
+
+    table[0][sq] = white_attacks;
+    table[1][sq] = black_attacks;
+  }
+  return table;
+}
+
+/**
+ * Builds the squares strictly between two squares on a shared rank, file or
+ * diagonal (0 if they are not aligned). With fullLine set, builds the whole
+ * board-wide line through both squares instead.
+ */
+constexpr std::array<std::array<uint64_t, 64>, 64>
+generateLines(bool fullLine) {
+  std::array<std::array<uint64_t, 64>, 64> table{};
+  for (int from = 0; from < 64; from++) {
+    for (int to = 0; to < 64; to++) {
+      int rankDelta = to / 8 - from / 8;
+      int fileDelta = to % 8 - from % 8;
+      bool aligned = rankDelta == 0 || fileDelta == 0 ||
+                     rankDelta == fileDelta || rankDelta == -fileDelta;
+      if (from == to || !aligned)
+        continue;
+
+      int rankStep = (rankDelta > 0) - (rankDelta < 0);
+      int fileStep = (fileDelta > 0) - (fileDelta < 0);
+      uint64_t squares = 0;
+
+      if (fullLine) {
+        // walk back to the edge, then forward to the other edge
+        int rank = from / 8;
+        int file = from % 8;
+        while (rank - rankStep >= 0 && rank - rankStep < 8 &&
+               file - fileStep >= 0 && file - fileStep < 8) {
+          rank -= rankStep;
+          file -= fileStep;
+        }
+        for (; rank >= 0 && rank < 8 && file >= 0 && file < 8;
+             rank += rankStep, file += fileStep)
+          squares |= 1ULL << (rank * 8 + file);
+      } else {
+        for (int sq = from + rankStep * 8 + fileStep; sq != to;
+             sq += rankStep * 8 + fileStep)
+          squares |= 1ULL << sq;
+      }
+
+      table[from][to] = squares;
+    }
+  }
+  return table;
+}
+
+inline constexpr std::array<uint64_t, 64> KING_ATTACKS = generateKingAttacks();
+inline constexpr std::array<uint64_t, 64> KNIGHT_ATTACKS =
+    generateKnightAttacks();
+/// Pawn attacks for each color/square
+inline constexpr std::array<std::array<uint64_t, 64>, 2> PAWN_ATTACKS =
+    generatePawnAttacks();
+/// Squares between two aligned squares, exclusive
+inline constexpr std::array<std::array<uint64_t, 64>, 64> BETWEEN_SQUARES =
+    generateLines(false);
+/// Full line through two aligned squares, including both
+inline constexpr std::array<std::array<uint64_t, 64>, 64> LINE_SQUARES =
+    generateLines(true);
+
+#endif
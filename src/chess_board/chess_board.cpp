@@ -1,48 +1,42 @@
 #include "chess_board.h"
+#include "../attacks/attacks.h"
+#include "../log/log.h"
 #include "../magics/magics.h"
+#include "../psqt/psqt.h"
+#include "../zobrist/zobrist.h"
+#include <algorithm>
 #include <cstdint>
+#include <cstdlib>
 #include <iostream>
 
 ChessBoard::ChessBoard() {
-  initMagics();
-  initAttacks();
+  ensureMagics();
   reset();
 }
 
-// TODO: use this later
-bool ChessBoard::isSquareAttacked(int square, bool byWhite) const {
-  uint64_t potentialPawnLocations = pawn_attacks[byWhite ? 0 : 1][square];
-  if (potentialPawnLocations & (byWhite ? whitePawns : blackPawns)) {
-    return true;
-  }
-
-  uint64_t potentialKnightLocations = knight_attacks[square];
-  if (potentialKnightLocations & (byWhite ? whiteKnights : blackKnights)) {
-    return true;
+ChessBoard::ChessBoard(std::string_view fen) {
+  ensureMagics();
+  if (!loadFen(fen)) {
+    loadFen(STARTING_FEN);
   }
+}
 
-  uint64_t potentialKingLocations = king_attacks[square];
-  if (potentialKingLocations & (byWhite ? whiteKing : blackKing)) {
-    return true;
-  }
+uint64_t ChessBoard::attackersTo(int square, uint64_t occupied) const {
+  // a white pawn attacks this square from where a black pawn on it would attack
+  return (PAWN_ATTACKS[1][square] & whitePawns) |
+         (PAWN_ATTACKS[0][square] & blackPawns) |
+         (KNIGHT_ATTACKS[square] & (whiteKnights | blackKnights)) |
+         (KING_ATTACKS[square] & (whiteKing | blackKing)) |
+         (getRookAttacks(square, occupied) &
+          (whiteRooks | blackRooks | whiteQueens | blackQueens)) |
+         (getBishopAttacks(square, occupied) &
+          (whiteBishops | blackBishops | whiteQueens | blackQueens));
+}
 
+bool ChessBoard::isSquareAttacked(int square, bool byWhite) const {
   uint64_t allPieces = getWhitePieces() | getBlackPieces();
-
-  // Rook + Queen
-  uint64_t potentialRookLocations = getRookAttacks(square, allPieces);
-  if (potentialRookLocations &
-      (byWhite ? (whiteRooks | whiteQueens) : (blackRooks | blackQueens))) {
-    return true;
-  }
-
-  // Bishop + Queen
-  uint64_t potentialBishopLocations = getBishopAttacks(square, allPieces);
-  if (potentialBishopLocations &
-      (byWhite ? (whiteBishops | whiteQueens) : (blackBishops | blackQueens))) {
-    return true;
-  }
-
-  return false;
+  return attackersTo(square, allPieces) &
+         (byWhite ? getWhitePieces() : getBlackPieces());
 }
 
 bool ChessBoard::isInCheck(bool white) const {
@@ -54,15 +48,32 @@ bool ChessBoard::isInCheck(bool white) const {
   return isKingAttacked;
 }
 
-bool ChessBoard::testMove(Move &move) {
-  ChessBoard tempBoard = *this;
-  if (tempBoard.isInCheck(!tempBoard.sideToMove)) {
-    std::cout << "Move leaves king in check\n";
-    return false;
+uint64_t ChessBoard::pinnedPieces(int kingSquare) const {
+  bool white = sideToMove == 0;
+  uint64_t ownPieces = white ? getWhitePieces() : getBlackPieces();
+  uint64_t occupied = getWhitePieces() | getBlackPieces();
+
+  // enemy sliders that would see the king on an empty board
+  uint64_t snipers =
+      (getRookAttacks(kingSquare, 0) &
+       (white ? blackRooks | blackQueens : whiteRooks | whiteQueens)) |
+      (getBishopAttacks(kingSquare, 0) &
+       (white ? blackBishops | blackQueens : whiteBishops | whiteQueens));
+
+  uint64_t pinned = 0;
+  while (snipers) {
+    int sniper = __builtin_ctzll(snipers);
+    uint64_t blockers = BETWEEN_SQUARES[kingSquare][sniper] & occupied;
+
+    // exactly one piece in the way, and it is ours
+    if (blockers && !(blockers & (blockers - 1))) {
+      pinned |= blockers & ownPieces;
+    }
+    snipers &= snipers - 1;
   }
 
-  return true;
-};
+  return pinned;
+}
 
 bool ChessBoard::hasInsufficientMaterial() const {
   uint64_t allPieces = getWhitePieces() | getBlackPieces();
@@ -111,25 +122,17 @@ bool ChessBoard::hasInsufficientMaterial() const {
 }
 
 bool ChessBoard::isCheckmate() const {
-  if (!isInCheck(sideToMove)) {
+  if (!isInCheck(sideToMove == 0)) {
     return false;
   }
 
-  ChessBoard tempBoard = *this;
-  tempBoard.generateMoves();
-
-  for (Move move : tempBoard.moves) {
-    ChessBoard testBoard = tempBoard;
-    if (testBoard.makeMove(move)) {
-      return false;
-    }
-  }
-
-  return true;
+  MoveList moves;
+  generateMoves(moves);
+  return moves.empty();
 }
 
 bool ChessBoard::isStalemate() const {
-  if (isInCheck(sideToMove)) {
+  if (isInCheck(sideToMove == 0)) {
     return false;
   }
 
@@ -140,270 +143,357 @@ bool ChessBoard::isStalemate() const {
     return true;
   }
 
-  ChessBoard tempBoard = *this;
-  tempBoard.generateMoves();
+  MoveList moves;
+  generateMoves(moves);
+  return moves.empty();
+}
 
-  for (Move move : tempBoard.moves) {
-    ChessBoard testBoard = tempBoard;
-    if (testBoard.makeMove(move)) {
-      return false;
-    }
+const char *moveErrorName(MoveError error) {
+  switch (error) {
+  case MoveError::None:
+    return "legal";
+  case MoveError::EmptySquare:
+    return "no piece on the source square";
+  case MoveError::WrongSide:
+    return "wrong side to move";
+  case MoveError::Illegal:
+    return "illegal move";
   }
-
-  return true;
+  return "unknown";
 }
 
-bool ChessBoard::isMoveLegal(Move &move) {
-  Piece movingPiece = board[move.from];
-
-  std::cout << "Checking move from " << (int)move.from << " to " << (int)move.to
-            << "\n";
-  std::cout << "Moving piece: " << int(movingPiece) << "\n";
-
+MoveError ChessBoard::validateMove(Move &move) const {
+  Piece movingPiece = board[move.from()];
   if (movingPiece == Piece::Empty) {
-    std::cout << "Empty square selected\n";
-    return false;
+    return MoveError::EmptySquare;
   }
 
   bool isWhitePiece = movingPiece <= Piece::WhiteKing;
-  std::cout << "Is white piece: " << isWhitePiece << "\n";
-
   if (sideToMove == isWhitePiece) {
-    std::cout << "Wrong side to move\n";
-    return false;
+    return MoveError::WrongSide;
   }
 
-  // get all legal moves for the piece
-  moves.clear();
-  uint64_t ownPieces = isWhitePiece ? getWhitePieces() : getBlackPieces();
-  uint64_t enemyPieces = isWhitePiece ? getBlackPieces() : getWhitePieces();
-  uint64_t fromBB = 1ULL << move.from;
+  // legal moves are only generated for the whole position
+  MoveList moves;
+  generateMoves(moves);
+
+  for (const Move &m : moves) {
+    if (m.from() == move.from() && m.to() == move.to()) {
+      move = m;
+      return MoveError::None;
+    }
+  }
+
+  LOG(Debug, "No legal move from %d to %d", move.from(), move.to());
+  return MoveError::Illegal;
+}
+
+// the low three bits of a Piece give its type, 1 for pawns of either color
+static bool isPawn(Piece piece) { return (uint8_t(piece) & 7) == 1; }
+
+/**
+ * Castling rights that survive a move from or to each square: moving the
+ * king or a rook, or capturing a rook, drops the rights that need it.
+ */
+constexpr std::array<uint8_t, 64> generateCastlingMasks() {
+  std::array<uint8_t, 64> table{};
+  for (int square = 0; square < 64; square++) {
+    table[square] = AllCastling;
+  }
+  table[0] &= ~WhiteQueenSide;
+  table[4] &= ~(WhiteKingSide | WhiteQueenSide);
+  table[7] &= ~WhiteKingSide;
+  table[56] &= ~BlackQueenSide;
+  table[60] &= ~(BlackKingSide | BlackQueenSide);
+  table[63] &= ~BlackKingSide;
+  return table;
+}
 
-  // check if the move is in the list of legal moves depending on piece
-  switch (movingPiece) {
+static constexpr std::array<uint8_t, 64> CASTLING_MASKS =
+    generateCastlingMasks();
+
+uint64_t &ChessBoard::pieceBitboard(Piece piece) {
+  switch (piece) {
   case Piece::WhitePawn:
-  case Piece::BlackPawn:
-    generatePawnMoves(isWhitePiece ? 0 : 1, fromBB, ownPieces, enemyPieces);
-    break;
-  case Piece::WhiteKing:
-  case Piece::BlackKing:
-    generateKingMoves(fromBB, ownPieces, enemyPieces);
-    break;
+    return whitePawns;
   case Piece::WhiteKnight:
-  case Piece::BlackKnight:
-    generateKnightMoves(fromBB, ownPieces, enemyPieces);
-    break;
+    return whiteKnights;
   case Piece::WhiteBishop:
-  case Piece::BlackBishop:
-    generateBishopMoves(fromBB, ownPieces, enemyPieces);
-    break;
+    return whiteBishops;
   case Piece::WhiteRook:
-  case Piece::BlackRook:
-    generateRookMoves(fromBB, ownPieces, enemyPieces);
-    break;
+    return whiteRooks;
   case Piece::WhiteQueen:
+    return whiteQueens;
+  case Piece::WhiteKing:
+    return whiteKing;
+  case Piece::BlackPawn:
+    return blackPawns;
+  case Piece::BlackKnight:
+    return blackKnights;
+  case Piece::BlackBishop:
+    return blackBishops;
+  case Piece::BlackRook:
+    return blackRooks;
   case Piece::BlackQueen:
-    generateQueenMoves(fromBB, ownPieces, enemyPieces);
-    break;
-  default:
-    return false;
+    return blackQueens;
+  default: // callers never pass Piece::Empty
+    return blackKing;
   }
+}
 
-  // validate the move
-  std::cout << "Generated " << moves.size() << " moves\n";
-  for (const Move &m : moves) {
-    std::cout << "Possible move: " << (int)m.from << " to " << (int)m.to
-              << "\n";
-    if (m.from == move.from && m.to == move.to) {
-      std::cout << "Found matching move!\n";
-      return true;
+void ChessBoard::makeMove(const Move &move, BoardState &state) {
+  uint8_t from = move.from();
+  uint8_t to = move.to();
+  uint8_t flags = move.flags();
+
+  Piece movingPiece = board[from];
+  // en passant captures the pawn beside the destination, not on it
+  uint8_t captureSquare =
+      flags == MoveFlag::EnPassant ? (sideToMove ? to + 8 : to - 8) : to;
+  Piece capturedPiece = board[captureSquare];
+
+  state.zobristKey = zobristKey;
+  state.pawnKey = pawnKey;
+  state.psqtScore = psqtScore;
+  state.move = move;
+  state.capturedPiece = capturedPiece;
+  state.enPassantSquare = enPassantSquare;
+  state.castlingRights = castlingRights;
+  state.halfMoveClock = halfMoveClock;
+  state.phase = phase;
+
+  uint64_t toBB = 1ULL << to;
+  uint64_t fromBB = 1ULL << from;
+
+  if (capturedPiece != Piece::Empty) {
+    pieceBitboard(capturedPiece) ^= 1ULL << captureSquare;
+    board[captureSquare] = Piece::Empty;
+    zobristKey ^= ZOBRIST.pieces[uint8_t(capturedPiece)][captureSquare];
+    psqtScore -= PSQT[uint8_t(capturedPiece)][captureSquare];
+    phase -= PHASE_WEIGHTS[uint8_t(capturedPiece)];
+    if (isPawn(capturedPiece)) {
+      pawnKey ^= ZOBRIST.pieces[uint8_t(capturedPiece)][captureSquare];
     }
   }
 
-  std::cout << "No matching move found\n";
+  Piece placedPiece = movingPiece;
+  if (move.isPromotion()) {
+    // knight, bishop, rook, queen follow each other in Piece
+    placedPiece = Piece(uint8_t(sideToMove ? Piece::BlackKnight
+                                           : Piece::WhiteKnight) +
+                        (flags & 3));
+  }
+  pieceBitboard(movingPiece) ^= fromBB;
+  pieceBitboard(placedPiece) ^= toBB;
+  zobristKey ^= ZOBRIST.pieces[uint8_t(movingPiece)][from] ^
+                ZOBRIST.pieces[uint8_t(placedPiece)][to];
+  psqtScore +=
+      PSQT[uint8_t(placedPiece)][to] - PSQT[uint8_t(movingPiece)][from];
+  phase += PHASE_WEIGHTS[uint8_t(placedPiece)] -
+           PHASE_WEIGHTS[uint8_t(movingPiece)];
+  if (isPawn(movingPiece)) {
+    pawnKey ^= ZOBRIST.pieces[uint8_t(movingPiece)][from];
+    if (placedPiece == movingPiece) {
+      pawnKey ^= ZOBRIST.pieces[uint8_t(movingPiece)][to];
+    }
+  }
 
-  return false;
-}
+  board[to] = placedPiece;
+  board[from] = Piece::Empty;
+
+  if (move.isCastle()) {
+    // rook jumps from its corner to the square the king passed over
+    bool kingSide = flags == MoveFlag::KingCastle;
+    uint8_t rookFrom = kingSide ? to + 1 : to - 2;
+    uint8_t rookTo = kingSide ? to - 1 : to + 1;
+    Piece rook = board[rookFrom];
+
+    pieceBitboard(rook) ^= (1ULL << rookFrom) | (1ULL << rookTo);
+    board[rookTo] = rook;
+    board[rookFrom] = Piece::Empty;
+    zobristKey ^= ZOBRIST.pieces[uint8_t(rook)][rookFrom] ^
+                  ZOBRIST.pieces[uint8_t(rook)][rookTo];
+    psqtScore += PSQT[uint8_t(rook)][rookTo] - PSQT[uint8_t(rook)][rookFrom];
+  }
 
-bool ChessBoard::makeMove(Move &move) {
-  if (!isMoveLegal(move)) {
-    std::cout << "Illegal move\n";
-    return false;
+  halfMoveClock += halfMoveClock < UINT16_MAX;
+  if (capturedPiece != Piece::Empty || isPawn(movingPiece)) {
+    halfMoveClock = 0;
   }
 
-  BoardState prevState = {enPassantSquare, sideToMove,     castlingRights,
-                          halfMoveClock,   fullMoveNumber, Piece::Empty};
+  if (sideToMove) {
+    fullMoveNumber++;
+  }
 
-  // Check if move leaves king in check
-  if (!testMove(move)) {
-    return false;
+  if (castlingRights) {
+    uint8_t rights = castlingRights & CASTLING_MASKS[from] & CASTLING_MASKS[to];
+    zobristKey ^= ZOBRIST.castling[castlingRights] ^ ZOBRIST.castling[rights];
+    castlingRights = rights;
+  }
+
+  // Pawn double push opens an en passant square behind the pawn
+  if (enPassantSquare != 0xFF) {
+    zobristKey ^= ZOBRIST.enPassantFile[enPassantSquare % 8];
+  }
+  enPassantSquare = 0xFF;
+  if (flags == MoveFlag::DoublePawnPush) {
+    enPassantSquare = (from + to) / 2;
+    zobristKey ^= ZOBRIST.enPassantFile[enPassantSquare % 8];
   }
 
-  Piece movingPiece = board[move.from];
-  prevState.capturedPiece = board[move.to];
+  sideToMove = !sideToMove;
+  zobristKey ^= ZOBRIST.blackToMove;
 
-  uint64_t toBB = 1ULL << move.to;
-  uint64_t fromBB = 1ULL << move.from;
+#ifdef ZOBRIST_DEBUG
+  checkZobristKey();
+#endif
+}
 
-  if (prevState.capturedPiece != Piece::Empty) {
-    switch (prevState.capturedPiece) {
-    case Piece::Empty:
-      return false;
-    case Piece::WhitePawn:
-      whitePawns &= ~toBB;
-      break;
-    case Piece::WhiteKnight:
-      whiteKnights &= ~toBB;
-      break;
-    case Piece::WhiteBishop:
-      whiteBishops &= ~toBB;
-      break;
-    case Piece::WhiteRook:
-      whiteRooks &= ~toBB;
-      break;
-    case Piece::WhiteQueen:
-      whiteQueens &= ~toBB;
-      break;
-    case Piece::WhiteKing:
-      whiteKing &= ~toBB;
-      break;
-    case Piece::BlackPawn:
-      blackPawns &= ~toBB;
-      break;
-    case Piece::BlackKnight:
-      blackKnights &= ~toBB;
-      break;
-    case Piece::BlackBishop:
-      blackBishops &= ~toBB;
-      break;
-    case Piece::BlackRook:
-      blackRooks &= ~toBB;
-    case Piece::BlackQueen:
-      blackQueens &= ~toBB;
-      break;
-    case Piece::BlackKing:
-      blackKing &= ~toBB;
-      break;
-    }
-  }
-
-  halfMoveClock++;
-  if (prevState.capturedPiece != Piece::Empty ||
-      movingPiece == Piece::WhitePawn || movingPiece == Piece::BlackPawn) {
-    halfMoveClock = 0;
-  }
+void ChessBoard::unmakeMove(const BoardState &state) {
+  const Move &move = state.move;
+  uint8_t from = move.from();
+  uint8_t to = move.to();
 
+  sideToMove = !sideToMove;
   if (sideToMove) {
-    fullMoveNumber++;
+    fullMoveNumber--;
   }
 
-  switch (movingPiece) {
-  case Piece::Empty:
-    return false;
-  case Piece::WhitePawn:
-    whitePawns ^= fromBB; // Remove from source square
-    whitePawns |= toBB;   // Add to destination square
-    break;
-  case Piece::WhiteKnight:
-    whiteKnights ^= fromBB;
-    whiteKnights |= toBB;
-    break;
-  case Piece::WhiteBishop:
-    whiteBishops ^= fromBB;
-    whiteBishops |= toBB;
-    break;
-  case Piece::WhiteRook:
-    whiteRooks ^= fromBB;
-    whiteRooks |= toBB;
-    if (move.from == 0)
-      castlingRights.erase(castlingRights.find('Q'));
-    if (move.from == 7)
-      castlingRights.erase(castlingRights.find('K'));
-    break;
-  case Piece::WhiteQueen:
-    whiteQueens ^= fromBB;
-    whiteQueens |= toBB;
-    break;
-  case Piece::WhiteKing:
-    whiteKing ^= fromBB;
-    whiteKing |= toBB;
-    // TODO: Handle castling
-    break;
-  case Piece::BlackPawn:
-    blackPawns ^= fromBB;
-    blackPawns |= toBB;
-    break;
-  case Piece::BlackKnight:
-    blackKnights ^= fromBB;
-    blackKnights |= toBB;
-    break;
-  case Piece::BlackBishop:
-    blackBishops ^= fromBB;
-    blackBishops |= toBB;
-    break;
-  case Piece::BlackRook:
-    blackRooks ^= fromBB;
-    blackRooks |= toBB;
-    if (move.from == 56)
-      castlingRights.erase(castlingRights.find('q'));
-    if (move.from == 63)
-      castlingRights.erase(castlingRights.find('k'));
-    break;
-  case Piece::BlackQueen:
-    blackQueens ^= fromBB;
-    blackQueens |= toBB;
-    break;
-  case Piece::BlackKing:
-    blackKing ^= fromBB;
-    blackKing |= toBB;
+  uint64_t toBB = 1ULL << to;
+  uint64_t fromBB = 1ULL << from;
 
-    // TODO: Handle castling
-    break;
+  // a promoted piece is taken off and the pawn goes back
+  Piece placedPiece = board[to];
+  Piece movedPiece = placedPiece;
+  if (move.isPromotion()) {
+    movedPiece = sideToMove ? Piece::BlackPawn : Piece::WhitePawn;
+  }
+  pieceBitboard(placedPiece) ^= toBB;
+  pieceBitboard(movedPiece) ^= fromBB;
+  board[from] = movedPiece;
+  board[to] = Piece::Empty;
+
+  if (state.capturedPiece != Piece::Empty) {
+    uint8_t captureSquare =
+        move.isEnPassant() ? (sideToMove ? to + 8 : to - 8) : to;
+    pieceBitboard(state.capturedPiece) |= 1ULL << captureSquare;
+    board[captureSquare] = state.capturedPiece;
   }
 
-  board[move.to] = board[move.from];
-  board[move.from] = Piece::Empty;
+  if (move.isCastle()) {
+    bool kingSide = move.flags() == MoveFlag::KingCastle;
+    uint8_t rookFrom = kingSide ? to + 1 : to - 2;
+    uint8_t rookTo = kingSide ? to - 1 : to + 1;
+    Piece rook = board[rookTo];
 
-  // reset en passant
-  enPassantSquare = 0xFF;
+    pieceBitboard(rook) ^= (1ULL << rookFrom) | (1ULL << rookTo);
+    board[rookFrom] = rook;
+    board[rookTo] = Piece::Empty;
+  }
+
+  enPassantSquare = state.enPassantSquare;
+  castlingRights = state.castlingRights;
+  halfMoveClock = state.halfMoveClock;
+  zobristKey = state.zobristKey;
+  pawnKey = state.pawnKey;
+  psqtScore = state.psqtScore;
+  phase = state.phase;
+
+#ifdef ZOBRIST_DEBUG
+  checkZobristKey();
+#endif
+}
+
+uint64_t ChessBoard::getPieceBitboard(Piece piece) const {
+  // pieceBitboard only hands out a reference, reading through it is safe
+  return const_cast<ChessBoard *>(this)->pieceBitboard(piece);
+}
 
-  // Handle pawn double push
-  if ((movingPiece == Piece::WhitePawn && move.from / 8 == 1 &&
-       move.to / 8 == 3) ||
-      (movingPiece == Piece::BlackPawn && move.from / 8 == 6 &&
-       move.to / 8 == 4)) {
-    enPassantSquare = (move.from + move.to) / 2;
+bool BoardHistory::isRepetition(const ChessBoard &board) const {
+  // Positions before the last capture or pawn move cannot come back, and
+  // only every other one has the same side to move
+  int size = states.size();
+  int limit = std::min<int>(board.getHalfMoveClock(), size);
+  uint64_t key = board.getZobristKey();
+
+  for (int i = 2; i <= limit; i += 2) {
+    if (states[size - i].zobristKey == key) {
+      return true;
+    }
   }
 
-  sideToMove = !sideToMove;
+  return false;
+}
 
-  stateHistory.push_back(prevState);
+bool BoardHistory::isDraw(const ChessBoard &board) const {
+  return board.getHalfMoveClock() >= 100 || isRepetition(board) ||
+         board.hasInsufficientMaterial();
+}
 
-  return true;
-};
+uint64_t ChessBoard::computeZobristKey() const {
+  uint64_t key = 0;
 
-void ChessBoard::unmakeMove() {
-  if (stateHistory.empty())
-    return;
+  for (int square = 0; square < 64; square++) {
+    if (board[square] != Piece::Empty) {
+      key ^= ZOBRIST.pieces[uint8_t(board[square])][square];
+    }
+  }
+  key ^= ZOBRIST.castling[castlingRights];
+  if (enPassantSquare != 0xFF) {
+    key ^= ZOBRIST.enPassantFile[enPassantSquare % 8];
+  }
+  if (sideToMove) {
+    key ^= ZOBRIST.blackToMove;
+  }
+
+  return key;
+}
+
+int32_t ChessBoard::computePsqtScore() const {
+  int32_t score = 0;
+
+  for (int square = 0; square < 64; square++) {
+    score += PSQT[uint8_t(board[square])][square];
+  }
+
+  return score;
+}
+
+int ChessBoard::computePhase() const {
+  int total = 0;
+
+  for (int square = 0; square < 64; square++) {
+    total += PHASE_WEIGHTS[uint8_t(board[square])];
+  }
+
+  return total;
+}
 
-  BoardState prevState = stateHistory.back();
-  stateHistory.pop_back();
+uint64_t ChessBoard::computePawnKey() const {
+  uint64_t key = 0;
 
-  enPassantSquare = prevState.enPassantSquare;
-  sideToMove = prevState.sideToMove;
-  castlingRights = prevState.castlingRights;
-  halfMoveClock = prevState.halfMoveClock;
-  fullMoveNumber = prevState.fullMoveNumber;
+  for (uint64_t pawns = whitePawns; pawns; pawns &= pawns - 1) {
+    key ^= ZOBRIST.pieces[uint8_t(Piece::WhitePawn)][__builtin_ctzll(pawns)];
+  }
+  for (uint64_t pawns = blackPawns; pawns; pawns &= pawns - 1) {
+    key ^= ZOBRIST.pieces[uint8_t(Piece::BlackPawn)][__builtin_ctzll(pawns)];
+  }
 
-  // TODO: Restore piece positions
-  // Requires storing the move that was made
-  // Might need to extend the BoardState to include the move
+  return key;
 }
 
-void ChessBoard::initAttacks() {
-  initKingAttacks();
-  initKnightAttacks();
-  initPawnAttacks();
+void ChessBoard::checkZobristKey() const {
+  uint64_t expected = computeZobristKey();
+  if (zobristKey != expected) {
+    LOG(Error, "Zobrist key mismatch: %016llx != %016llx in %s",
+        (unsigned long long)zobristKey, (unsigned long long)expected,
+        getFen().c_str());
+    std::abort();
+  }
+  if (pawnKey != computePawnKey()) {
+    LOG(Error, "Pawn key mismatch in %s", getFen().c_str());
+    std::abort();
+  }
 }
 
 void ChessBoard::displayBitboard(uint64_t bitboard) const {
@@ -446,7 +536,7 @@ void ChessBoard::displayAttacks(int square, uint64_t attacks,
 
 void ChessBoard::displayKingAttacks(int square) const {
   std::cout << "King attacks from square " << square << ":\n";
-  uint64_t attacks = king_attacks[square];
+  uint64_t attacks = KING_ATTACKS[square];
 
   for (int rank = 7; rank >= 0; rank--) {
     std::cout << (rank + 1) << " ";
@@ -468,7 +558,7 @@ void ChessBoard::displayKingAttacks(int square) const {
 
 void ChessBoard::displayKnightAttacks(int square) const {
   std::cout << "Knight attacks from square " << square << ":\n";
-  uint64_t attacks = knight_attacks[square];
+  uint64_t attacks = KNIGHT_ATTACKS[square];
 
   // Display board with possible knight moves
   for (int rank = 7; rank >= 0; rank--) {
@@ -489,123 +579,68 @@ void ChessBoard::displayKnightAttacks(int square) const {
   std::cout << "  a b c d e f g h" << std::endl;
 }
 
+/**
+ * Adds a move from one square to each destination. The flag is fixed at
+ * compile time when the generator type allows only captures or quiets.
+ */
+template <GenType Type>
+static void addMoves(uint8_t from, uint64_t destinations,
+                     uint64_t enemyPieces, MoveList &moves) {
+  while (destinations) {
+    uint8_t to = __builtin_ctzll(destinations);
+    uint8_t flags;
+    if constexpr (Type == GenType::Captures) {
+      flags = MoveFlag::Capture;
+    } else if constexpr (Type == GenType::Quiets) {
+      flags = MoveFlag::Quiet;
+    } else {
+      flags = (enemyPieces >> to) & 1 ? MoveFlag::Capture : MoveFlag::Quiet;
+    }
+    moves.push_back(Move{from, to, flags});
+    destinations &= destinations - 1;
+  }
+}
+
+template <GenType Type>
 void ChessBoard::generateBishopMoves(uint64_t bishops, uint64_t ownPieces,
-                                     uint64_t enemyPieces) {
+                                     uint64_t enemyPieces, uint64_t targets,
+                                     MoveList &moves) const {
   while (bishops) {
     int square = __builtin_ctzll(bishops);
     uint64_t attacks = getBishopAttacks(square, ownPieces | enemyPieces);
-    attacks &= ~ownPieces; // Remove squares occupied by own pieces
-
-    while (attacks) {
-      int to = __builtin_ctzll(attacks);
-      moves.push_back(Move{(uint8_t)square, (uint8_t)to});
-      attacks &= attacks - 1;
-    }
-
+    addMoves<Type>(square, attacks & targets, enemyPieces, moves);
     bishops &= bishops - 1;
   }
 }
 
+template <GenType Type>
 void ChessBoard::generateRookMoves(uint64_t rooks, uint64_t ownPieces,
-                                   uint64_t enemyPieces) {
+                                   uint64_t enemyPieces, uint64_t targets,
+                                   MoveList &moves) const {
   while (rooks) {
     int square = __builtin_ctzll(rooks);
     uint64_t attacks = getRookAttacks(square, ownPieces | enemyPieces);
-    attacks &= ~ownPieces; // Remove squares occupied by own pieces
-
-    while (attacks) {
-      int to = __builtin_ctzll(attacks);
-      moves.push_back(Move{(uint8_t)square, (uint8_t)to});
-      attacks &= attacks - 1;
-    }
-
+    addMoves<Type>(square, attacks & targets, enemyPieces, moves);
     rooks &= rooks - 1;
   }
 }
 
+template <GenType Type>
 void ChessBoard::generateQueenMoves(uint64_t queens, uint64_t ownPieces,
-                                    uint64_t enemyPieces) {
+                                    uint64_t enemyPieces, uint64_t targets,
+                                    MoveList &moves) const {
   while (queens) {
     int square = __builtin_ctzll(queens);
-    uint64_t attacks = getRookAttacks(square, ownPieces | enemyPieces) |
-                       getBishopAttacks(square, ownPieces | enemyPieces);
-    attacks &= ~ownPieces;
-
-    while (attacks) {
-      int to = __builtin_ctzll(attacks);
-      moves.push_back(Move{(uint8_t)square, (uint8_t)to});
-      attacks &= attacks - 1;
-    }
-
+    uint64_t attacks = getQueenAttacks(square, ownPieces | enemyPieces);
+    addMoves<Type>(square, attacks & targets, enemyPieces, moves);
     queens &= queens - 1;
   }
 }
 
-void ChessBoard::initKingAttacks() {
-  for (int sq = 0; sq < 64; sq++) {
-    uint64_t attacks = 0;
-    int rank = sq / 8;
-    int file = sq % 8;
-
-    // Up
-    if (rank < 7) {
-      attacks |= 1ULL << (sq + 8); // up
-      if (file > 0)
-        attacks |= 1ULL << (sq + 7); // Up
-      if (file < 7)
-        attacks |= 1ULL << (sq + 9); // Up-left
-    }
-
-    // Same rank
-    if (file > 0)
-      attacks |= 1ULL << (sq - 1); // Left
-    if (file < 7)
-      attacks |= 1ULL << (sq + 1); // Right
-
-    // Down
-    if (rank > 0) {
-      attacks |= 1ULL << (sq - 8); // Down
-      if (file > 0)
-        attacks |= 1ULL << (sq - 9); // Down-left
-      if (file < 7)
-        attacks |= 1ULL << (sq - 7); // Down-right
-    }
-
-    king_attacks[sq] = attacks;
-  }
-}
-
-void ChessBoard::initKnightAttacks() {
-  for (int sq = 0; sq < 64; sq++) {
-    uint64_t attacks = 0;
-    int rank = sq / 8;
-    int file = sq % 8;
-
-    if (rank < 6 && file < 7)
-      attacks |= 1ULL << (sq + 17);
-    if (rank < 6 && file > 0)
-      attacks |= 1ULL << (sq + 15);
-    if (rank < 7 && file < 6)
-      attacks |= 1ULL << (sq + 10);
-    if (rank > 0 && file < 6)
-      attacks |= 1ULL << (sq - 6);
-    if (rank > 1 && file < 7)
-      attacks |= 1ULL << (sq - 15);
-    if (rank > 1 && file > 0)
-      attacks |= 1ULL << (sq - 17);
-    if (rank < 7 && file > 1)
-      attacks |= 1ULL << (sq + 6);
-    if (rank > 0 && file > 1)
-      attacks |= 1ULL << (sq - 10);
-
-    knight_attacks[sq] = attacks;
-  }
-};
-
 void ChessBoard::displayPawnAttacks(int side, int square) const {
   std::cout << "Side: " << side << "\nPawn attacks from square " << square
             << ":\n";
-  uint64_t attacks = pawn_attacks[side][square];
+  uint64_t attacks = PAWN_ATTACKS[side][square];
 
   for (int rank = 7; rank >= 0; rank--) {
     std::cout << (rank + 1) << " ";
@@ -628,189 +663,643 @@ void ChessBoard::displayPawnAttacks(int side, int square) const {
   std::cout << "  a b c d e f g h" << std::endl;
 }
 
-void ChessBoard::initPawnAttacks() {
-  // side 0: white, side 1: black
-  for (int sq = 0; sq < 64; sq++) {
-    uint64_t white_attacks = 0;
-    uint64_t black_attacks = 0;
-    int rank = sq / 8;
-    int file = sq % 8;
-
-    if (rank < 7) {
-      if (file == 0) {
-        white_attacks |= 1ULL << (sq + 9);
-      } else if (file == 7) {
-        white_attacks |= 1ULL << (sq + 7);
-      } else {
-        white_attacks |= 1ULL << (sq + 7);
-        white_attacks |= 1ULL << (sq + 9);
-      }
-    }
+/**
+ * Adds one move per destination, coming from the square offset back.
+ */
+static void addPawnMoves(uint64_t destinations, int offset, uint8_t flags,
+                         MoveList &moves) {
+  while (destinations) {
+    uint8_t to = __builtin_ctzll(destinations);
+    moves.push_back(Move{uint8_t(to - offset), to, flags});
+    destinations &= destinations - 1;
+  }
+}
 
-    if (rank > 0) {
-      if (file == 0) {
-        black_attacks |= 1ULL << (sq - 7);
-      } else if (file == 7) {
-        black_attacks |= 1ULL << (sq - 9);
-      } else {
-        black_attacks |= 1ULL << (sq - 7);
-        black_attacks |= 1ULL << (sq - 9);
-      }
+/**
+ * Adds the four promotions per destination, queen first so input matching
+ * picks it by default.
+ */
+static void addPromotions(uint64_t destinations, int offset, bool capture,
+                          MoveList &moves) {
+  uint8_t queen =
+      capture ? MoveFlag::QueenPromotionCapture : MoveFlag::QueenPromotion;
+  while (destinations) {
+    uint8_t to = __builtin_ctzll(destinations);
+    for (int piece = 0; piece < 4; piece++) {
+      moves.push_back(Move{uint8_t(to - offset), to, uint8_t(queen - piece)});
     }
-
-    pawn_attacks[0][sq] = white_attacks;
-    pawn_attacks[1][sq] = black_attacks;
+    destinations &= destinations - 1;
   }
 }
 
+template <GenType Type>
 void ChessBoard::generatePawnMoves(uint8_t side, uint64_t pawns,
-                                   uint64_t ownPieces, uint64_t enemyPieces) {
-  int forward = (side == 0) ? 8 : -8; // white moves up, black moves down
+                                   uint64_t ownPieces, uint64_t enemyPieces,
+                                   uint64_t targets, MoveList &moves) const {
+  constexpr bool noisy = Type != GenType::Quiets;
+  constexpr bool quiet = Type != GenType::Captures;
+
   uint64_t emptySquares = ~(ownPieces | enemyPieces);
+  uint64_t promotionRank = side == 0 ? RANK_8 : RANK_1;
+
+  // All pawns move at once: shift the whole set one step forward, or one
+  // step diagonally with the wrapping file masked off first
+  int forward = side == 0 ? 8 : -8;
+  int west = side == 0 ? 7 : -9;
+  int east = side == 0 ? 9 : -7;
+  uint64_t pushes, westCaptures, eastCaptures;
+  if (side == 0) {
+    pushes = pawns << 8;
+    westCaptures = (pawns & ~FILE_A) << 7;
+    eastCaptures = (pawns & ~FILE_H) << 9;
+  } else {
+    pushes = pawns >> 8;
+    westCaptures = (pawns & ~FILE_A) >> 9;
+    eastCaptures = (pawns & ~FILE_H) >> 7;
+  }
+  pushes &= emptySquares;
+  westCaptures &= enemyPieces & targets;
+  eastCaptures &= enemyPieces & targets;
+
+  if constexpr (quiet) {
+    // a second step from the start rank; the first square may be off target
+    // since only the landing square can block a check
+    uint64_t doublePushes = side == 0 ? (pushes << 8) & RANK_4
+                                      : (pushes >> 8) & RANK_5;
+    doublePushes &= emptySquares & targets;
+
+    addPawnMoves(pushes & targets & ~promotionRank, forward, MoveFlag::Quiet,
+                 moves);
+    addPawnMoves(doublePushes, 2 * forward, MoveFlag::DoublePawnPush, moves);
+  }
 
-  while (pawns != 0) {
-    uint8_t from = __builtin_ctzll(pawns);
+  if constexpr (noisy) {
+    addPromotions(pushes & targets & promotionRank, forward, false, moves);
+    addPromotions(westCaptures & promotionRank, west, true, moves);
+    addPromotions(eastCaptures & promotionRank, east, true, moves);
+    addPawnMoves(westCaptures & ~promotionRank, west, MoveFlag::Capture,
+                 moves);
+    addPawnMoves(eastCaptures & ~promotionRank, east, MoveFlag::Capture,
+                 moves);
+  }
+}
 
-    uint64_t to = 1ULL << (from + forward);
-    if (to & emptySquares) {
-      moves.push_back(Move{from, uint8_t(from + forward)});
-
-      // check for double pawn push
-      if ((side == 0 && from >= 8 && from < 16) ||
-          (side == 1 && from >= 48 && from < 56)) {
-        uint64_t double_push = 1ULL << (from + 2 * forward);
-        if (double_push & emptySquares) {
-          moves.push_back(Move{from, uint8_t(from + 2 * forward)});
-        }
-      }
-    }
+void ChessBoard::generateEnPassantMoves(uint64_t checkers, uint64_t movers,
+                                        MoveList &moves) const {
+  if (enPassantSquare == 0xFF) {
+    return;
+  }
+
+  bool white = sideToMove == 0;
+  uint8_t captureSquare = white ? enPassantSquare - 8 : enPassantSquare + 8;
+  uint64_t capturedBB = 1ULL << captureSquare;
 
-    // capturing
-    uint64_t captures = pawn_attacks[side][from] & enemyPieces;
-    while (captures != 0) {
-      uint8_t to = __builtin_ctzll(captures);
-      moves.push_back({from, to});
-      captures &= captures - 1;
+  // a check from anything but the pushed pawn (or a slider it uncovered,
+  // caught below) is not resolved by taking the pawn
+  uint64_t enemyLeapers =
+      white ? blackKnights | blackPawns : whiteKnights | whitePawns;
+  if (checkers & enemyLeapers & ~capturedBB) {
+    return;
+  }
+
+  int kingSquare = __builtin_ctzll(white ? whiteKing : blackKing);
+  uint64_t enemyRooks =
+      white ? blackRooks | blackQueens : whiteRooks | whiteQueens;
+  uint64_t enemyBishops =
+      white ? blackBishops | blackQueens : whiteBishops | whiteQueens;
+  uint64_t occupied = getWhitePieces() | getBlackPieces();
+
+  // a white pawn can capture onto the square from where a black pawn on it
+  // would attack
+  uint64_t pawns = PAWN_ATTACKS[white ? 1 : 0][enPassantSquare] &
+                   (white ? whitePawns : blackPawns) & movers;
+  while (pawns) {
+    uint8_t from = __builtin_ctzll(pawns);
+
+    // both pawns leave their squares at once, so check the king directly
+    uint64_t after =
+        (occupied ^ (1ULL << from) ^ capturedBB) | (1ULL << enPassantSquare);
+    if (!(getRookAttacks(kingSquare, after) & enemyRooks) &&
+        !(getBishopAttacks(kingSquare, after) & enemyBishops)) {
+      moves.push_back(Move{from, enPassantSquare, MoveFlag::EnPassant});
     }
 
-    // clear bit
     pawns &= pawns - 1;
   }
 }
 
+template <GenType Type>
 void ChessBoard::generateKingMoves(uint64_t king, uint64_t ownPieces,
-                                   uint64_t enemyPieces) {
-  while (king != 0) {
-    uint8_t from = __builtin_ctzll(king); // get index of least significant bit
+                                   uint64_t enemyPieces, uint64_t targets,
+                                   MoveList &moves) const {
+  uint8_t from = __builtin_ctzll(king);
+
+  // the king must not hide behind itself from a slider
+  uint64_t occupied = (ownPieces | enemyPieces) ^ king;
+
+  uint64_t destinations = KING_ATTACKS[from] & targets;
+  uint64_t safe = 0;
+  while (destinations != 0) {
+    uint8_t to = __builtin_ctzll(destinations);
+    if (!(attackersTo(to, occupied) & enemyPieces)) {
+      safe |= 1ULL << to;
+    }
+    destinations &= destinations - 1;
+  }
 
-    uint64_t destinations = king_attacks[from];
-    destinations &= ~ownPieces; // remove own pieces
+  addMoves<Type>(from, safe, enemyPieces, moves);
+}
 
-    while (destinations != 0) {
-      uint8_t to = __builtin_ctzll(destinations);
-      moves.push_back(Move{from, to});
-      destinations &= destinations - 1;
-    }
+void ChessBoard::generateCastlingMoves(MoveList &moves) const {
+  uint64_t occupied = getWhitePieces() | getBlackPieces();
+  bool white = sideToMove == 0;
+  uint8_t kingSquare = white ? 4 : 60;
+
+  if (!castlingRights) {
+    return;
+  }
+
+  // f and g files must be empty and safe
+  uint64_t kingSidePath = 0x60ULL << (white ? 0 : 56);
+  if ((castlingRights & (white ? WhiteKingSide : BlackKingSide)) &&
+      !(occupied & kingSidePath) &&
+      !isSquareAttacked(kingSquare + 1, !white) &&
+      !isSquareAttacked(kingSquare + 2, !white)) {
+    moves.push_back(Move{kingSquare, uint8_t(kingSquare + 2),
+                         MoveFlag::KingCastle});
+  }
 
-    // clear bit
-    king &= king - 1;
+  // b, c and d files must be empty, only c and d need to be safe
+  uint64_t queenSidePath = 0x0EULL << (white ? 0 : 56);
+  if ((castlingRights & (white ? WhiteQueenSide : BlackQueenSide)) &&
+      !(occupied & queenSidePath) &&
+      !isSquareAttacked(kingSquare - 1, !white) &&
+      !isSquareAttacked(kingSquare - 2, !white)) {
+    moves.push_back(Move{kingSquare, uint8_t(kingSquare - 2),
+                         MoveFlag::QueenCastle});
   }
 }
 
-void ChessBoard::generateKnightMoves(uint64_t knights, uint64_t ownPieces,
-                                     uint64_t enemyPieces) {
+template <GenType Type>
+void ChessBoard::generateKnightMoves(uint64_t knights, uint64_t enemyPieces,
+                                     uint64_t targets, MoveList &moves) const {
   while (knights != 0) {
-    uint8_t from =
-        __builtin_ctzll(knights); // get index of least significant bit
+    uint8_t from = __builtin_ctzll(knights);
+    addMoves<Type>(from, KNIGHT_ATTACKS[from] & targets, enemyPieces, moves);
+    knights &= knights - 1;
+  }
+}
+
+template <GenType Type>
+void ChessBoard::generate(MoveList &moves, uint64_t movers) const {
+  moves.clear();
+  bool white = sideToMove == 0;
+  uint64_t ownPieces = white ? getWhitePieces() : getBlackPieces();
+  uint64_t enemyPieces = white ? getBlackPieces() : getWhitePieces();
+  uint64_t king = white ? whiteKing : blackKing;
+  int kingSquare = __builtin_ctzll(king);
 
-    uint64_t destinations = knight_attacks[from];
-    destinations &= ~ownPieces; // remove own pieces
+  // pieces other than pawns only need to know which squares to go to
+  uint64_t typeTargets = Type == GenType::Captures ? enemyPieces
+                         : Type == GenType::Quiets ? ~(ownPieces | enemyPieces)
+                                                   : ~ownPieces;
 
-    while (destinations != 0) {
-      uint8_t to = __builtin_ctzll(destinations);
-      moves.push_back(Move{from, to});
-      destinations &= destinations - 1;
+  uint64_t checkers =
+      attackersTo(kingSquare, ownPieces | enemyPieces) & enemyPieces;
+
+  if (king & movers) {
+    generateKingMoves<Type>(king, ownPieces, enemyPieces, typeTargets, moves);
+  }
+
+  // in double check only the king can move
+  if (checkers & (checkers - 1)) {
+    return;
+  }
+
+  // in check, other pieces must capture the checker or block its line
+  uint64_t targets = ~0ULL;
+  if (checkers) {
+    targets = checkers | BETWEEN_SQUARES[kingSquare][__builtin_ctzll(checkers)];
+  } else if constexpr (Type == GenType::Quiets || Type == GenType::All) {
+    if (king & movers) {
+      generateCastlingMoves(moves);
     }
+  }
 
-    // clear bit
-    knights &= knights - 1;
+  if constexpr (Type != GenType::Quiets) {
+    generateEnPassantMoves(checkers, movers, moves);
+  }
+
+  uint64_t pinned = pinnedPieces(kingSquare);
+  uint64_t knights = (white ? whiteKnights : blackKnights) & movers;
+  uint64_t pawns = (white ? whitePawns : blackPawns) & movers;
+  uint64_t rooks = (white ? whiteRooks : blackRooks) & movers;
+  uint64_t bishops = (white ? whiteBishops : blackBishops) & movers;
+  uint64_t queens = (white ? whiteQueens : blackQueens) & movers;
+  uint64_t pieceTargets = targets & typeTargets;
+
+  // pinned knights can never move
+  generateKnightMoves<Type>(knights & ~pinned, enemyPieces, pieceTargets,
+                            moves);
+  generatePawnMoves<Type>(sideToMove, pawns & ~pinned, ownPieces,
+                          enemyPieces, targets, moves);
+  generateRookMoves<Type>(rooks & ~pinned, ownPieces, enemyPieces,
+                          pieceTargets, moves);
+  generateBishopMoves<Type>(bishops & ~pinned, ownPieces, enemyPieces,
+                            pieceTargets, moves);
+  generateQueenMoves<Type>(queens & ~pinned, ownPieces, enemyPieces,
+                           pieceTargets, moves);
+
+  // pinned pieces stay on the line through their king and the pinner
+  uint64_t pinnedMovers = pinned & movers & ~knights;
+  while (pinnedMovers) {
+    int square = __builtin_ctzll(pinnedMovers);
+    uint64_t piece = 1ULL << square;
+    uint64_t line = LINE_SQUARES[kingSquare][square];
+
+    if (piece & pawns) {
+      generatePawnMoves<Type>(sideToMove, piece, ownPieces, enemyPieces,
+                              targets & line, moves);
+    } else if (piece & rooks) {
+      generateRookMoves<Type>(piece, ownPieces, enemyPieces,
+                              pieceTargets & line, moves);
+    } else if (piece & bishops) {
+      generateBishopMoves<Type>(piece, ownPieces, enemyPieces,
+                                pieceTargets & line, moves);
+    } else {
+      generateQueenMoves<Type>(piece, ownPieces, enemyPieces,
+                               pieceTargets & line, moves);
+    }
+
+    pinnedMovers &= pinnedMovers - 1;
   }
 }
 
-void ChessBoard::generateMoves() {
-  moves.clear();
-  uint64_t ownPieces = (sideToMove == 0) ? getWhitePieces() : getBlackPieces();
-  uint64_t enemyPieces =
-      (sideToMove == 0) ? getBlackPieces() : getWhitePieces();
-
-  generateKnightMoves((sideToMove == 0) ? whiteKnights : blackKnights,
-                      ownPieces, enemyPieces);
-  generatePawnMoves(sideToMove, (sideToMove == 0) ? whitePawns : blackPawns,
-                    ownPieces, enemyPieces);
-  generateRookMoves((sideToMove == 0) ? whiteRooks : blackRooks, ownPieces,
-                    enemyPieces);
-  generateBishopMoves((sideToMove == 0) ? whiteBishops : blackBishops,
-                      ownPieces, enemyPieces);
-  generateQueenMoves((sideToMove == 0) ? whiteQueens : blackQueens, ownPieces,
-                     enemyPieces);
-  generateKingMoves((sideToMove == 0) ? whiteKing : blackKing, ownPieces,
-                    enemyPieces);
+// the generator is used from the header for every type
+template void ChessBoard::generate<GenType::Captures>(MoveList &,
+                                                      uint64_t) const;
+template void ChessBoard::generate<GenType::Quiets>(MoveList &,
+                                                    uint64_t) const;
+template void ChessBoard::generate<GenType::Evasions>(MoveList &,
+                                                      uint64_t) const;
+template void ChessBoard::generate<GenType::All>(MoveList &, uint64_t) const;
+
+bool ChessBoard::isLegal(Move move) const {
+  uint64_t from = 1ULL << move.from();
+  uint64_t ownPieces = sideToMove == 0 ? getWhitePieces() : getBlackPieces();
+  if (move == Move::none() || !(from & ownPieces)) {
+    return false;
+  }
+
+  MoveList moves;
+  if (move.isCapture() || move.isPromotion()) {
+    generate<GenType::Captures>(moves, from);
+  } else {
+    generate<GenType::Quiets>(moves, from);
+  }
+  return std::find(moves.begin(), moves.end(), move) != moves.end();
 }
 
 void ChessBoard::reset() {
-  sideToMove = 0;
-  castlingRights = "KQkq";
-  halfMoveClock = 0;
-  fullMoveNumber = 1;
-
-  // White pieces (rank 1-2)
-  whitePawns = 0x000000000000FF00ULL;
-  whiteKnights = 0x0000000000000042ULL;
-  whiteBishops = 0x0000000000000024ULL;
-  whiteRooks = 0x0000000000000081ULL;
-  whiteQueens = 0x0000000000000008ULL;
-  whiteKing = 0x0000000000000010ULL;
-
-  // Black pieces (rank 7-8)
-  blackPawns = 0x00FF000000000000ULL;
-  blackKnights = 0x4200000000000000ULL;
-  blackBishops = 0x2400000000000000ULL;
-  blackRooks = 0x8100000000000000ULL;
-  blackQueens = 0x0800000000000000ULL;
-  blackKing = 0x1000000000000000ULL;
-
-  // Initialize array representation
-  for (int i = 0; i < 64; i++) {
-    board[i] = Piece::Empty;
-  }
-
-  // First rank (white pieces)
-  board[0] = Piece::WhiteRook;
-  board[1] = Piece::WhiteKnight;
-  board[2] = Piece::WhiteBishop;
-  board[3] = Piece::WhiteQueen; // Changed order
-  board[4] = Piece::WhiteKing;  // Changed order
-  board[5] = Piece::WhiteBishop;
-  board[6] = Piece::WhiteKnight;
-  board[7] = Piece::WhiteRook;
-
-  // Rest unchanged as array indexes already match the standard convention
-  for (int i = 8; i < 16; i++)
-    board[i] = Piece::WhitePawn; // 2nd rank
-  for (int i = 48; i < 56; i++)
-    board[i] = Piece::BlackPawn; // 7th rank
-
-  // Eighth rank (black pieces)
-  board[56] = Piece::BlackRook;
-  board[57] = Piece::BlackKnight;
-  board[58] = Piece::BlackBishop;
-  board[59] = Piece::BlackQueen; // Changed order
-  board[60] = Piece::BlackKing;  // Changed order
-  board[61] = Piece::BlackBishop;
-  board[62] = Piece::BlackKnight;
-  board[63] = Piece::BlackRook;
-
-  std::cout << "Game at state 0" << std::endl;
+  loadFen(STARTING_FEN);
+  LOG(Debug, "Board reset to the starting position");
+}
+
+/**
+ * Piece for each FEN letter, Piece::Empty for any other character.
+ */
+constexpr std::array<Piece, 128> generateFenPieces() {
+  std::array<Piece, 128> table{};
+  table['P'] = Piece::WhitePawn;
+  table['N'] = Piece::WhiteKnight;
+  table['B'] = Piece::WhiteBishop;
+  table['R'] = Piece::WhiteRook;
+  table['Q'] = Piece::WhiteQueen;
+  table['K'] = Piece::WhiteKing;
+  table['p'] = Piece::BlackPawn;
+  table['n'] = Piece::BlackKnight;
+  table['b'] = Piece::BlackBishop;
+  table['r'] = Piece::BlackRook;
+  table['q'] = Piece::BlackQueen;
+  table['k'] = Piece::BlackKing;
+  return table;
+}
+
+static constexpr std::array<Piece, 128> FEN_PIECES = generateFenPieces();
+
+/// FEN letter of each Piece value
+static const char FEN_LETTERS[] = " PNBRQK  pnbrqk";
+
+/// Castling rights in FEN order, with the king and rook they need
+static const struct {
+  char letter;
+  CastlingRight right;
+  Piece king;
+  uint8_t kingSquare;
+  uint8_t rookSquare;
+} CASTLING_SETUP[4] = {
+    {'K', WhiteKingSide, Piece::WhiteKing, 4, 7},
+    {'Q', WhiteQueenSide, Piece::WhiteKing, 4, 0},
+    {'k', BlackKingSide, Piece::BlackKing, 60, 63},
+    {'q', BlackQueenSide, Piece::BlackKing, 60, 56},
+};
+
+/**
+ * Splits the next space-separated field off a FEN.
+ *
+ * @param rest Unparsed part of the FEN, advanced past the field
+ * @return The field, empty if there is none left
+ */
+static std::string_view nextFenField(std::string_view &rest) {
+  size_t start = rest.find_first_not_of(' ');
+  if (start == std::string_view::npos) {
+    rest = std::string_view();
+    return rest;
+  }
+  size_t end = std::min(rest.find(' ', start), rest.size());
+  std::string_view field = rest.substr(start, end - start);
+  rest.remove_prefix(end);
+  return field;
+}
+
+/**
+ * Parses a move counter. A missing counter keeps the default.
+ *
+ * @param field Digits of the counter, or empty
+ * @param value Set to the counter, capped at max
+ * @param max Largest value the counter can hold
+ * @return false if the field is not a number
+ */
+static bool parseFenCounter(std::string_view field, int &value, int max) {
+  if (field.empty()) {
+    return true;
+  }
+  int parsed = 0;
+  for (char c : field) {
+    if (c < '0' || c > '9') {
+      return false;
+    }
+    parsed = std::min(parsed * 10 + (c - '0'), max);
+  }
+  value = parsed;
+  return true;
+}
+
+/**
+ * Writes a number in decimal.
+ *
+ * @return Position after the last digit
+ */
+static char *writeFenCounter(char *out, unsigned value) {
+  char digits[10];
+  int count = 0;
+  do {
+    digits[count++] = '0' + value % 10;
+    value /= 10;
+  } while (value);
+  while (count) {
+    *out++ = digits[--count];
+  }
+  return out;
+}
+
+bool ChessBoard::loadFen(std::string_view fen) {
+  std::string_view placement = nextFenField(fen);
+  std::string_view side = nextFenField(fen);
+  std::string_view castling = nextFenField(fen);
+  std::string_view enPassant = nextFenField(fen);
+  std::string_view halfMoves = nextFenField(fen);
+  std::string_view fullMoves = nextFenField(fen);
+
+  // Everything is parsed into locals first so a bad FEN leaves the board
+  // untouched. The keys and scores are summed in the same pass.
+  std::array<Piece, 64> pieces{};
+  uint64_t bitboards[15] = {};
+  uint64_t key = 0;
+  uint64_t pawns = 0;
+  int32_t score = 0;
+  int totalPhase = 0;
+
+  // FEN lists ranks from 8 down to 1, files a to h
+  int rank = 7;
+  int file = 0;
+  for (char c : placement) {
+    if (c == '/') {
+      if (file != 8 || rank == 0) {
+        return false;
+      }
+      rank--;
+      file = 0;
+      continue;
+    }
+    if (c >= '1' && c <= '8') {
+      file += c - '0';
+      if (file > 8) {
+        return false;
+      }
+      continue;
+    }
+
+    Piece piece = (unsigned char)c < 128 ? FEN_PIECES[c] : Piece::Empty;
+    if (piece == Piece::Empty || file > 7) {
+      return false;
+    }
+    int square = rank * 8 + file++;
+    pieces[square] = piece;
+    bitboards[uint8_t(piece)] |= 1ULL << square;
+    key ^= ZOBRIST.pieces[uint8_t(piece)][square];
+    if (isPawn(piece)) {
+      pawns ^= ZOBRIST.pieces[uint8_t(piece)][square];
+    }
+    score += PSQT[uint8_t(piece)][square];
+    totalPhase += PHASE_WEIGHTS[uint8_t(piece)];
+  }
+  if (rank != 0 || file != 8 ||
+      __builtin_popcountll(bitboards[uint8_t(Piece::WhiteKing)]) != 1 ||
+      __builtin_popcountll(bitboards[uint8_t(Piece::BlackKing)]) != 1) {
+    return false;
+  }
+
+  // At most 16 pieces a side and no pawns on the back ranks: fixed-size
+  // buffers such as the NNUE feature lists rely on both
+  uint64_t white = 0;
+  uint64_t black = 0;
+  for (int piece = 1; piece <= 6; piece++) {
+    white |= bitboards[piece];
+    black |= bitboards[piece + 8];
+  }
+  if (__builtin_popcountll(white) > 16 || __builtin_popcountll(black) > 16 ||
+      ((bitboards[uint8_t(Piece::WhitePawn)] |
+        bitboards[uint8_t(Piece::BlackPawn)]) &
+       (RANK_1 | RANK_8))) {
+    return false;
+  }
+
+  if (side != "w" && side != "b") {
+    return false;
+  }
+  bool blackToMove = side == "b";
+
+  uint8_t rights = 0;
+  if (castling != "-") {
+    if (castling.empty() || castling.size() > 4) {
+      return false;
+    }
+    for (const auto &setup : CASTLING_SETUP) {
+      size_t count =
+          std::count(castling.begin(), castling.end(), setup.letter);
+      if (count > 1) {
+        return false;
+      }
+      Piece rook = setup.king == Piece::WhiteKing ? Piece::WhiteRook
+                                                  : Piece::BlackRook;
+      if (count && pieces[setup.kingSquare] == setup.king &&
+          pieces[setup.rookSquare] == rook) {
+        rights |= setup.right;
+      }
+    }
+    if (castling.find_first_not_of("KQkq") != std::string_view::npos) {
+      return false;
+    }
+  }
+
+  uint8_t epSquare = 0xFF;
+  if (enPassant != "-") {
+    if (enPassant.size() != 2 || enPassant[0] < 'a' || enPassant[0] > 'h' ||
+        enPassant[1] != (blackToMove ? '3' : '6')) {
+      return false;
+    }
+    epSquare = (enPassant[1] - '1') * 8 + (enPassant[0] - 'a');
+
+    // The pawn that just pushed two squares stands in front of the target,
+    // which it crossed, coming from its now empty start square
+    int pawnSquare = blackToMove ? epSquare + 8 : epSquare - 8;
+    int startSquare = blackToMove ? epSquare - 8 : epSquare + 8;
+    Piece pushed = blackToMove ? Piece::WhitePawn : Piece::BlackPawn;
+    if (pieces[epSquare] != Piece::Empty || pieces[pawnSquare] != pushed ||
+        pieces[startSquare] != Piece::Empty) {
+      return false;
+    }
+    key ^= ZOBRIST.enPassantFile[epSquare % 8];
+  }
+
+  int halfMoveCount = 0;
+  int fullMoveCount = 1;
+  if (!parseFenCounter(halfMoves, halfMoveCount, UINT16_MAX) ||
+      !parseFenCounter(fullMoves, fullMoveCount, UINT16_MAX)) {
+    return false;
+  }
+
+  // The check test below needs the new position in place, so keep the old
+  // one to restore if it fails
+  ChessBoard previous = *this;
+
+  whitePawns = bitboards[uint8_t(Piece::WhitePawn)];
+  whiteKnights = bitboards[uint8_t(Piece::WhiteKnight)];
+  whiteBishops = bitboards[uint8_t(Piece::WhiteBishop)];
+  whiteRooks = bitboards[uint8_t(Piece::WhiteRook)];
+  whiteQueens = bitboards[uint8_t(Piece::WhiteQueen)];
+  whiteKing = bitboards[uint8_t(Piece::WhiteKing)];
+  blackPawns = bitboards[uint8_t(Piece::BlackPawn)];
+  blackKnights = bitboards[uint8_t(Piece::BlackKnight)];
+  blackBishops = bitboards[uint8_t(Piece::BlackBishop)];
+  blackRooks = bitboards[uint8_t(Piece::BlackRook)];
+  blackQueens = bitboards[uint8_t(Piece::BlackQueen)];
+  blackKing = bitboards[uint8_t(Piece::BlackKing)];
+  board = pieces;
+
+  sideToMove = blackToMove;
+  if (blackToMove) {
+    key ^= ZOBRIST.blackToMove;
+  }
+  key ^= ZOBRIST.castling[rights];
+  castlingRights = rights;
+  enPassantSquare = epSquare;
+  halfMoveClock = halfMoveCount;
+  fullMoveNumber = std::max(fullMoveCount, 1);
+
+  zobristKey = key;
+  pawnKey = pawns;
+  psqtScore = score;
+  phase = totalPhase;
+
+  // With the side not to move in check its king could be captured
+  if (isInCheck(blackToMove)) {
+    *this = previous;
+    return false;
+  }
+
+  return true;
+}
+
+size_t ChessBoard::writeFen(char *buffer) const {
+  char *out = buffer;
+
+  for (int rank = 7; rank >= 0; rank--) {
+    int empty = 0;
+    for (int file = 0; file < 8; file++) {
+      Piece piece = board[rank * 8 + file];
+      if (piece == Piece::Empty) {
+        empty++;
+        continue;
+      }
+      if (empty) {
+        *out++ = '0' + empty;
+        empty = 0;
+      }
+      *out++ = FEN_LETTERS[uint8_t(piece)];
+    }
+    if (empty) {
+      *out++ = '0' + empty;
+    }
+    *out++ = rank ? '/' : ' ';
+  }
+
+  *out++ = sideToMove ? 'b' : 'w';
+  *out++ = ' ';
+
+  if (!castlingRights) {
+    *out++ = '-';
+  }
+  for (const auto &setup : CASTLING_SETUP) {
+    if (castlingRights & setup.right) {
+      *out++ = setup.letter;
+    }
+  }
+  *out++ = ' ';
+
+  if (enPassantSquare == 0xFF) {
+    *out++ = '-';
+  } else {
+    *out++ = 'a' + enPassantSquare % 8;
+    *out++ = '1' + enPassantSquare / 8;
+  }
+  *out++ = ' ';
+
+  out = writeFenCounter(out, halfMoveClock);
+  *out++ = ' ';
+  out = writeFenCounter(out, fullMoveNumber);
+  *out = '\0';
+
+  return out - buffer;
+}
+
+std::string ChessBoard::getFen() const {
+  char buffer[FEN_BUFFER_SIZE];
+  size_t length = writeFen(buffer);
+  return std::string(buffer, length);
+}
+
+std::string moveToString(const Move &move) {
+  std::string result;
+  result += char('a' + move.from() % 8);
+  result += char('1' + move.from() / 8);
+  result += char('a' + move.to() % 8);
+  result += char('1' + move.to() / 8);
+  if (move.isPromotion()) {
+    result += "nbrq"[move.flags() & 3];
+  }
+  return result;
 }
 
 uint64_t ChessBoard::getWhitePieces() const {
@@ -826,8 +1315,17 @@ uint64_t ChessBoard::getBlackPieces() const {
 void ChessBoard::display() const {
   std::cout << "Side to move: " << (sideToMove == 0 ? "White" : "Black") << " "
             << sideToMove << std::endl;
-  std::cout << "Castling rights: " << castlingRights << std::endl;
-  std::cout << "Half move clock: " << halfMoveClock << std::endl;
+  std::cout << "Castling rights: ";
+  if (!castlingRights) {
+    std::cout << '-';
+  }
+  for (const auto &setup : CASTLING_SETUP) {
+    if (castlingRights & setup.right) {
+      std::cout << setup.letter;
+    }
+  }
+  std::cout << std::endl;
+  std::cout << "Half move clock: " << int(halfMoveClock) << std::endl;
   std::cout << "Full move number: " << fullMoveNumber << std::endl;
 
   // Display bitboard representation
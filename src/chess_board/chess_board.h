@@ -1,17 +1,104 @@
 #ifndef CHESS_BOARD_H
 #define CHESS_BOARD_H
 #include <array>
+#include <cstddef>
 #include <cstdint>
 #include <string>
+#include <string_view>
+#include <type_traits>
 #include <vector>
 
+/// FEN of the standard starting position
+inline constexpr const char *STARTING_FEN =
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+/// Buffer size that fits any FEN written by ChessBoard::writeFen
+const size_t FEN_BUFFER_SIZE = 128;
+
+/**
+ * Move kinds stored in the top 4 bits of a Move.
+ *
+ * Bit 2 marks captures and bit 3 promotions; for promotions the low two
+ * bits select the piece (knight, bishop, rook, queen).
+ */
+enum MoveFlag : uint8_t {
+  Quiet = 0,
+  DoublePawnPush = 1,
+  KingCastle = 2,
+  QueenCastle = 3,
+  Capture = 4,
+  EnPassant = 5,
+  KnightPromotion = 8,
+  BishopPromotion = 9,
+  RookPromotion = 10,
+  QueenPromotion = 11,
+  KnightPromotionCapture = 12,
+  BishopPromotionCapture = 13,
+  RookPromotionCapture = 14,
+  QueenPromotionCapture = 15
+};
+
 /**
- * Represents a chess move using source and destination squares.
+ * Represents a chess move packed into 16 bits:
+ * bits 0-5 source square, bits 6-11 destination square, bits 12-15 flags.
  */
 struct Move {
-  uint8_t from;
-  uint8_t to;
-  // TODO: Add promotion, capture flags, etc.
+  uint16_t data;
+
+  Move() = default;
+  constexpr Move(uint8_t from, uint8_t to, uint8_t flags = MoveFlag::Quiet)
+      : data(uint16_t(from | (to << 6) | (flags << 12))) {}
+
+  /**
+   * Placeholder for "no move" (a1 to a1 is never generated).
+   */
+  static constexpr Move none() { return Move(0, 0); }
+
+  constexpr uint8_t from() const { return data & 0x3F; }
+  constexpr uint8_t to() const { return (data >> 6) & 0x3F; }
+  constexpr uint8_t flags() const { return data >> 12; }
+
+  constexpr bool isCapture() const { return flags() & MoveFlag::Capture; }
+  constexpr bool isPromotion() const {
+    return flags() & MoveFlag::KnightPromotion;
+  }
+  constexpr bool isCastle() const {
+    return flags() == MoveFlag::KingCastle || flags() == MoveFlag::QueenCastle;
+  }
+  constexpr bool isEnPassant() const {
+    return flags() == MoveFlag::EnPassant;
+  }
+
+  constexpr bool operator==(const Move &other) const {
+    return data == other.data;
+  }
+  constexpr bool operator!=(const Move &other) const {
+    return data != other.data;
+  }
+};
+
+/**
+ * Fixed-capacity list of moves stored inline, so move generation never
+ * allocates. Callers keep one on the stack per ply.
+ */
+struct MoveList {
+  static const int CAPACITY = 256; /// Above the 218 moves any position allows
+
+  Move moves[CAPACITY];
+  int count = 0;
+
+  void push_back(const Move &move) { moves[count++] = move; }
+  void clear() { count = 0; }
+  int size() const { return count; }
+  bool empty() const { return count == 0; }
+
+  Move &operator[](int index) { return moves[index]; }
+  const Move &operator[](int index) const { return moves[index]; }
+
+  Move *begin() { return moves; }
+  Move *end() { return moves + count; }
+  const Move *begin() const { return moves; }
+  const Move *end() const { return moves + count; }
 };
 
 /**
@@ -38,17 +125,58 @@ enum class Piece : uint8_t {
   BlackKing = 14
 };
 
-/*
- * Represents the full game state including castling rights, en passant square,
- * and half/full move counters.
+/**
+ * Selects which moves a generator produces. Generators take it as a
+ * template argument, so the choice costs nothing per move.
+ */
+enum class GenType : uint8_t {
+  Captures, /// Captures, en passant and all promotions
+  Quiets,   /// All other moves, including castling
+  Evasions, /// All moves, for a side known to be in check
+  All,
+};
+
+/**
+ * Why a move from user input was rejected.
+ */
+enum class MoveError : uint8_t {
+  None,        /// The move is legal
+  EmptySquare, /// No piece on the source square
+  WrongSide,   /// The piece belongs to the side not to move
+  Illegal      /// The piece has no such legal move
+};
+
+/**
+ * Describes a move error for messages, e.g. "wrong side to move".
+ */
+const char *moveErrorName(MoveError error);
+
+/**
+ * Castling rights, one bit each, combined into a 4-bit mask.
+ */
+enum CastlingRight : uint8_t {
+  WhiteKingSide = 1,
+  WhiteQueenSide = 2,
+  BlackKingSide = 4,
+  BlackQueenSide = 8,
+  AllCastling = 15
+};
+
+/**
+ * What makeMove saves to take a move back: the move and the parts of the
+ * position that cannot be recomputed from it. A plain value, so callers
+ * keep one per ply on the stack or in an array.
  */
 struct BoardState {
-  uint8_t enPassantSquare;
-  bool sideToMove;
-  std::string castlingRights;
-  uint8_t halfMoveClock;
-  uint16_t fullMoveNumber;
+  uint64_t zobristKey; /// Key before the move, also used for repetitions
+  uint64_t pawnKey;
+  int32_t psqtScore;
+  Move move;
   Piece capturedPiece;
+  uint8_t enPassantSquare;
+  uint8_t castlingRights;
+  uint8_t phase;
+  uint16_t halfMoveClock;
 };
 
 /**
@@ -57,14 +185,12 @@ struct BoardState {
  *
  * Key features:
  * - Dual board representation (bitboards + 8x8 array)
- * - Pre-computed attack tables for pawns and knights
+ * - Shared compile-time attack tables for pawns, knights and kings
  * - Move generation for all piece types
  * - Full game state tracking (castling, en passant, etc.)
  */
 class ChessBoard {
 private:
-  std::vector<BoardState> stateHistory;
-
   // Bitboard representation - one 64-bit integer per piece type
   uint64_t whitePawns;
   uint64_t whiteKnights;
@@ -79,19 +205,17 @@ private:
   uint64_t blackQueens;
   uint64_t blackKing;
 
-  // Game state variables
-  uint8_t enPassantSquare;    /// Target square for en passant captures
-  std::string castlingRights; /// "KQkq" format - uppercase for white
-  uint8_t halfMoveClock;      /// Counts moves for 50-move rule
-  uint16_t fullMoveNumber;    /// Incremented after black's move
-
   std::array<Piece, 64> board; /// 8x8 array representation
-  std::vector<Move> moves;     /// Legal moves in current position
 
-  // Pre-computed attack lookup tables
-  uint64_t knight_attacks[64];  /// Knight move patterns for each square
-  uint64_t pawn_attacks[2][64]; /// Pawn attacks for each color/square
-  uint64_t king_attacks[64];
+  // Game state variables
+  uint64_t zobristKey;     /// Position hash, updated incrementally
+  uint64_t pawnKey;        /// Hash of the pawns only, updated incrementally
+  int32_t psqtScore;       /// Packed PSQT score for white, incremental
+  uint8_t enPassantSquare; /// Target square for en passant captures
+  uint8_t castlingRights;  /// CastlingRight bits still available
+  uint8_t phase;           /// Sum of PHASE_WEIGHTS, incremental
+  uint16_t halfMoveClock;  /// Counts moves for 50-move rule, saturating
+  uint16_t fullMoveNumber; /// Incremented after black's move
 
   /**
    * Checks if specified square is attacked by any enemy pieces
@@ -111,103 +235,151 @@ private:
   bool isInCheck(bool white) const;
 
   /**
-   * Tests if a move would leave king in check
+   * Finds the pieces of the side to move that are pinned to their king.
+   *
+   * @param kingSquare Square of the king of the side to move
+   * @return Own pieces that may only move along the line to their king
+   */
+  uint64_t pinnedPieces(int kingSquare) const;
+
+  /**
+   * Gets the bitboard that holds the given piece type.
    *
-   * @param move Move to check
-   * @return true if move is legal with checks
+   * @param piece Any piece other than Piece::Empty
+   * @return Reference to that piece's bitboard
    */
-  bool testMove(Move &move);
+  uint64_t &pieceBitboard(Piece piece);
 
   /**
-   * Validates consistency between bitboard and 8x8 array representations.
+   * Generates castling moves for the side to move, which must not be in
+   * check. Requires empty squares between king and rook, and that the king
+   * does not pass through or land on an attacked square.
    *
-   * @param Move to evaluate
+   * @param moves List to append the moves to
    */
-  bool isMoveLegal(Move &move);
+  void generateCastlingMoves(MoveList &moves) const;
 
   /**
-   * Generates pseudo-legal knight moves for the given knights.
+   * Generates knight moves for the given knights.
    *
    * @param knights Bitboard of knight positions to generate moves for
-   * @param ownPieces Bitboard of all friendly pieces (for blocking)
    * @param enemyPieces Bitboard of all enemy pieces (for captures)
+   * @param targets Bitboard of allowed destination squares
+   * @param moves List to append the moves to
    */
-  void generateKnightMoves(uint64_t knights, uint64_t ownPieces,
-                           uint64_t enemyPieces);
+  template <GenType Type>
+  void generateKnightMoves(uint64_t knights, uint64_t enemyPieces,
+                           uint64_t targets, MoveList &moves) const;
 
   /**
-   * Generates pseudo-legal pawn moves for the given side.
+   * Generates pawn pushes, captures and promotions for the given side.
+   * En passant is generated separately.
    *
    * @param side Color of pawns (0 = white, 1 = black)
    * @param pawns Bitboard of pawn positions to generate moves for
    * @param ownPieces Bitboard of all friendly pieces (for blocking)
    * @param enemyPieces Bitboard of all enemy pieces (for captures)
+   * @param targets Bitboard of allowed destination squares
+   * @param moves List to append the moves to
    */
+  template <GenType Type>
   void generatePawnMoves(uint8_t side, uint64_t pawns, uint64_t ownPieces,
-                         uint64_t enemyPieces);
+                         uint64_t enemyPieces, uint64_t targets,
+                         MoveList &moves) const;
+
+  /**
+   * Generates legal en passant captures for the side to move. Each one is
+   * tested for discovered checks along the rank or diagonal, since it
+   * removes two pawns at once.
+   *
+   * @param checkers Enemy pieces giving check
+   * @param movers Pawns allowed to capture
+   * @param moves List to append the moves to
+   */
+  void generateEnPassantMoves(uint64_t checkers, uint64_t movers,
+                              MoveList &moves) const;
 
   /**
-   * Generates pseudo-legal rook moves for the given rooks.
+   * Generates rook moves for the given rooks.
    *
    * @param rooks Bitboard of rook positions to generate moves for
    * @param ownPieces Bitboard of all friendly pieces (for blocking)
    * @param enemyPieces Bitboard of all enemy pieces (for captures)
+   * @param targets Bitboard of allowed destination squares
+   * @param moves List to append the moves to
    */
+  template <GenType Type>
   void generateRookMoves(uint64_t rooks, uint64_t ownPieces,
-                         uint64_t enemyPieces);
+                         uint64_t enemyPieces, uint64_t targets,
+                         MoveList &moves) const;
 
   /**
-   * Generates pseudo-legal bishop moves for the given bishops.
+   * Generates bishop moves for the given bishops.
    *
    * @param bishops Bitboard of bishop positions to generate moves for
    * @param ownPieces Bitboard of all friendly pieces (for blocking)
-   * @param enemyPieces Bitboard of all enemy pieces (for captures
+   * @param enemyPieces Bitboard of all enemy pieces (for captures)
+   * @param targets Bitboard of allowed destination squares
+   * @param moves List to append the moves to
    */
+  template <GenType Type>
   void generateBishopMoves(uint64_t bishops, uint64_t ownPieces,
-                           uint64_t enemyPieces);
+                           uint64_t enemyPieces, uint64_t targets,
+                           MoveList &moves) const;
 
   /**
-   * Generates pseudo-legal queen moves for the given queens.
+   * Generates queen moves for the given queens.
    *
    * @param queens Bitboard of queen positions to generate moves for
    * @param ownPieces Bitboard of all friendly pieces (for blocking)
    * @param enemyPieces Bitboard of all enemy pieces (for captures)
+   * @param targets Bitboard of allowed destination squares
+   * @param moves List to append the moves to
    */
+  template <GenType Type>
   void generateQueenMoves(uint64_t queens, uint64_t ownPieces,
-                          uint64_t enemyPieces);
-
-  void generateKingMoves(uint64_t king, uint64_t ownPieces,
-                         uint64_t enemyPieces);
-
-  /**
-   * Initializes pawn attack lookup table for both colors.
-   */
-  void initPawnAttacks();
+                          uint64_t enemyPieces, uint64_t targets,
+                          MoveList &moves) const;
 
   /**
-   * Initializes knight movement lookup table.
-   */
-  void initKnightAttacks();
-
-  /**
-   * Initializes king movement lookup table.
+   * Generates king steps to squares the enemy does not attack. Castling is
+   * generated separately.
+   *
+   * @param king Bitboard of the king
+   * @param ownPieces Bitboard of all friendly pieces (for blocking)
+   * @param enemyPieces Bitboard of all enemy pieces (for captures)
+   * @param targets Bitboard of allowed destination squares
+   * @param moves List to append the moves to
    */
-  void initKingAttacks();
+  template <GenType Type>
+  void generateKingMoves(uint64_t king, uint64_t ownPieces,
+                         uint64_t enemyPieces, uint64_t targets,
+                         MoveList &moves) const;
 
   /**
-   * Checks if current position has insufficient material for checkmate.
+   * Aborts if the incremental keys differ from a full recompute.
+   * Only compiled in with ZOBRIST_DEBUG.
    */
-  bool hasInsufficientMaterial() const;
+  void checkZobristKey() const;
 
 public:
   bool sideToMove; /// false = white, true = black
 
   /**
    * Constructs a chess board in the standard starting position.
-   * Initializes attack tables and resets game state.
+   * Initializes magic tables and resets game state.
    */
   ChessBoard();
 
+  /**
+   * Constructs a board from a FEN string without going through reset().
+   * Magic tables are only built by the first board of the process.
+   *
+   * @param fen Position in Forsyth-Edwards Notation; the starting position
+   *            is used if it cannot be parsed
+   */
+  explicit ChessBoard(std::string_view fen);
+
   /**
    * Checks if current position is a checkmate or stalemate
    *
@@ -223,19 +395,39 @@ public:
   bool isStalemate() const;
 
   /**
-   * Constructs a chess board from a given FEN string.
-   * Initializes attack tables and resets game state.
+   * Validates a move from user input against the legal moves of the
+   * position. Only the squares of the input are compared; on success the
+   * move gets the generated flags (promoting to a queen).
+   *
+   * @param move Move to evaluate, updated with its flags
+   * @return MoveError::None if the move is legal, otherwise the reason
+   */
+  MoveError validateMove(Move &move) const;
+
+  /**
+   * Same as validateMove, for callers that only need a yes or no.
+   *
+   * @param move Move to evaluate, updated with its flags
+   * @return true if the move is legal in the current position
+   */
+  bool isMoveLegal(Move &move) const {
+    return validateMove(move) == MoveError::None;
+  }
+
+  /**
+   * Makes a legal move (as produced by generateMoves or isMoveLegal).
    *
    * @param move Move to make
+   * @param state Filled with what unmakeMove needs to take the move back
    */
-  bool makeMove(Move &move);
+  void makeMove(const Move &move, BoardState &state);
 
   /**
-   * Undoes the last move made on the board.
-   * Restores the board state to the previous position
+   * Takes back the last move made on the board in O(1).
    *
+   * @param state State filled by the makeMove of that move
    */
-  void unmakeMove();
+  void unmakeMove(const BoardState &state);
 
   /**
    * Resets the board to the standard starting position.
@@ -243,12 +435,131 @@ public:
    */
   void reset();
 
+  /**
+   * Sets up the board from a FEN string, replacing the current position.
+   * Parses in place without allocating, so
+   * it is cheap enough to stream positions from a database.
+   *
+   * The move counters may be omitted (EPD style). Castling rights whose
+   * king or rook is not on its original square are dropped.
+   *
+   * @param fen Position in Forsyth-Edwards Notation
+   * @return true if the FEN could be parsed; otherwise the board is
+   *         unchanged
+   */
+  bool loadFen(std::string_view fen);
+
+  /**
+   * Writes the position as a FEN string, without allocating.
+   *
+   * @param buffer At least FEN_BUFFER_SIZE bytes; gets a NUL-terminated FEN
+   * @return Length of the FEN, not counting the NUL
+   */
+  size_t writeFen(char *buffer) const;
+
+  /**
+   * Gets the position as a FEN string.
+   */
+  std::string getFen() const;
+
   /**
    * Displays the current board state.
    * Shows ASCII board and raw 8x8 array values for debugging.
    */
   void display() const;
 
+  /**
+   * Gets the bitboard of a piece type.
+   *
+   * @param piece Any piece other than Piece::Empty
+   * @return Squares holding that piece
+   */
+  uint64_t getPieceBitboard(Piece piece) const;
+
+  /**
+   * Gets the piece on a square.
+   * @param square Square index (0-63)
+   */
+  Piece getPiece(int square) const { return board[square]; }
+
+  /**
+   * Checks if the side to move is in check.
+   */
+  bool inCheck() const { return isInCheck(sideToMove == 0); }
+
+  /**
+   * Finds the pieces of both colors that attack a square.
+   *
+   * @param square Square index (0-63)
+   * @param occupied Occupancy used to block sliding pieces
+   * @return Bitboard of attackers
+   */
+  uint64_t attackersTo(int square, uint64_t occupied) const;
+
+  /**
+   * Checks if current position has insufficient material for checkmate.
+   */
+  bool hasInsufficientMaterial() const;
+
+  /**
+   * Gets the moves since the last capture or pawn move.
+   */
+  int getHalfMoveClock() const { return halfMoveClock; }
+
+  /**
+   * Gets the castling rights still available.
+   * @return Mask of CastlingRight bits
+   */
+  uint8_t getCastlingRights() const { return castlingRights; }
+
+  /**
+   * Gets the Zobrist key of the current position.
+   * @return 64-bit position hash
+   */
+  uint64_t getZobristKey() const { return zobristKey; }
+
+  /**
+   * Computes the Zobrist key from scratch.
+   * @return 64-bit position hash
+   */
+  uint64_t computeZobristKey() const;
+
+  /**
+   * Gets the Zobrist key of the pawns alone, for the pawn hash table.
+   * @return 64-bit pawn structure hash
+   */
+  uint64_t getPawnKey() const { return pawnKey; }
+
+  /**
+   * Computes the pawn key from scratch.
+   * @return 64-bit pawn structure hash
+   */
+  uint64_t computePawnKey() const;
+
+  /**
+   * Gets the material + piece-square score, maintained by makeMove.
+   * @return Packed midgame/endgame score from white's point of view
+   */
+  int32_t getPsqtScore() const { return psqtScore; }
+
+  /**
+   * Gets the game phase, maintained by makeMove.
+   * @return Sum of PHASE_WEIGHTS of the pieces on the board
+   */
+  int getPhase() const { return phase; }
+
+  /**
+   * Computes the material + piece-square score from scratch.
+   * @return Packed midgame/endgame score from white's point of view
+   */
+  int32_t computePsqtScore() const;
+
+  /**
+   * Computes the game phase from scratch.
+   * @return Sum of PHASE_WEIGHTS of the pieces on the board
+   */
+  int computePhase() const;
+
   /**
    * Gets combined bitboard of all white pieces.
    * @return uint64_t Bitboard with white piece positions
@@ -261,11 +572,6 @@ public:
    */
   uint64_t getBlackPieces() const;
 
-  /**
-   * Initializes all piece movement lookup tables.
-   */
-  void initAttacks();
-
   /**
    * Shows all legal knight moves from given square.
    * @param square Square index (0-63) to show moves from
@@ -294,12 +600,146 @@ public:
   void displayAttacks(int square, uint64_t attacks, char piece) const;
 
   /**
-   * Generates all pseudo-legal moves in current position.
-   * Updates internal moves vector.
+   * Generates all legal moves in current position.
+   *
+   * Checkers and pinned pieces are found once up front: in check, moves
+   * must capture the checker or block its line, and pinned pieces may only
+   * move along the line to their king. No move needs to be tried out.
+   *
+   * @param moves List to fill, cleared first
+   */
+  void generateMoves(MoveList &moves) const {
+    generate<GenType::All>(moves);
+  }
+
+  /**
+   * Generates legal moves of one kind, e.g. generate<GenType::Captures>
+   * for quiescence search. Evasions must only be asked for in check.
+   *
+   * @param moves List to fill, cleared first
+   * @param movers Pieces of the side to move to generate moves for
+   */
+  template <GenType Type>
+  void generate(MoveList &moves, uint64_t movers = ~0ULL) const;
+
+  /**
+   * Generates legal captures, en passant and promotions.
+   * @param moves List to fill, cleared first
    */
-  void generateMoves();
+  void generateCaptures(MoveList &moves) const {
+    generate<GenType::Captures>(moves);
+  }
+
+  /**
+   * Generates legal moves that generateCaptures leaves out.
+   * @param moves List to fill, cleared first
+   */
+  void generateQuiets(MoveList &moves) const {
+    generate<GenType::Quiets>(moves);
+  }
+
+  /**
+   * Checks if a move, e.g. from the hash table or a killer slot, is legal
+   * in this position. Only the moves of the piece on its source square are
+   * generated.
+   *
+   * @param move Move to check, flags included
+   * @return true if generateMoves would produce exactly this move
+   */
+  bool isLegal(Move move) const;
 
   void displayBitboard(uint64_t bitboard) const;
 };
 
+// Boards are cloned per thread and batched by the thousand: copying one must
+// stay a small memcpy
+static_assert(std::is_trivially_copyable_v<ChessBoard>,
+              "ChessBoard must be trivially copyable");
+static_assert(sizeof(ChessBoard) <= 192, "ChessBoard must stay compact");
+static_assert(std::is_trivially_copyable_v<BoardState>,
+              "BoardState must be trivially copyable");
+
+/**
+ * The moves made on a board, as the states needed to take them back.
+ *
+ * A ChessBoard holds only the current position, so whoever makes moves on
+ * it keeps one of these alongside: a game for the moves played, a search
+ * for those plus the line it is looking at. It also answers the questions
+ * that need earlier positions, like repetitions.
+ */
+class BoardHistory {
+public:
+  BoardHistory() { states.reserve(1024); }
+
+  /**
+   * Makes a move on the board and records it.
+   *
+   * @param board Board this history belongs to
+   * @param move Legal move to make
+   */
+  void makeMove(ChessBoard &board, const Move &move) {
+    states.emplace_back();
+    board.makeMove(move, states.back());
+  }
+
+  /**
+   * Takes back the last recorded move.
+   *
+   * @param board Board this history belongs to
+   */
+  void unmakeMove(ChessBoard &board) {
+    board.unmakeMove(states.back());
+    states.pop_back();
+  }
+
+  /**
+   * Forgets all moves, e.g. after loading a new position.
+   */
+  void clear() { states.clear(); }
+
+  size_t size() const { return states.size(); }
+  bool empty() const { return states.empty(); }
+
+  /**
+   * Gets the state recorded by the last move. The history must not be
+   * empty.
+   */
+  const BoardState &back() const { return states.back(); }
+
+  /**
+   * Gets the move that led to the board's position.
+   * @return Last move made, or Move::none() at the start of the history
+   */
+  Move getLastMove() const {
+    return states.empty() ? Move::none() : states.back().move;
+  }
+
+  /**
+   * Checks if the board's position already occurred since the last capture
+   * or pawn move, with the same side to move.
+   *
+   * @param board Board this history belongs to
+   */
+  bool isRepetition(const ChessBoard &board) const;
+
+  /**
+   * Checks for a draw by repetition, the fifty-move rule or insufficient
+   * material. Stalemate needs move generation and is not included.
+   *
+   * @param board Board this history belongs to
+   */
+  bool isDraw(const ChessBoard &board) const;
+
+private:
+  std::vector<BoardState> states;
+};
+
+/**
+ * Formats a move in coordinate notation, e.g. "e2e4" or "e7e8q".
+ *
+ * @param move Move to format
+ * @return Move as source and destination square names
+ */
+std::string moveToString(const Move &move);
+
 #endif
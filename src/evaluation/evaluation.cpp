@@ -0,0 +1,49 @@
+#include "evaluation.h"
+#include "../psqt/psqt.h"
+#include <algorithm>
+
+const int PIECE_VALUES[15] = {
+    0,   100, 320, 330, 500, 900, 0, 0, // empty, white P N B R Q K
+    0,   100, 320, 330, 500, 900, 0,    // black P N B R Q K
+};
+
+/// Extra endgame bonus for a passed pawn whose next square is empty, by
+/// rank counted from the pawn's own side
+static const int FREE_PASSER[8] = {0, 0, 2, 5, 10, 20, 35, 0};
+
+/// Keeps static scores clear of mate scores, whatever a network returns
+static const int MAX_EVAL = 30000;
+
+int evaluate(const ChessBoard &board, PawnTable &pawnTable,
+             const AccumulatorStack *nnue) {
+  if (nnue && nnue->getNetwork()) {
+    int score = nnue->evaluate(board);
+    return std::clamp(score, -MAX_EVAL, MAX_EVAL);
+  }
+
+  PawnEntry &pawns = pawnTable.probe(board);
+  int32_t packed = board.getPsqtScore() + pawns.score +
+                   pawns.kingShelter(board, 0) + pawns.kingShelter(board, 1);
+
+  // Blockers change with every move, so this part of the passed pawn
+  // evaluation is done here rather than in the pawn table
+  uint64_t empty = ~(board.getWhitePieces() | board.getBlackPieces());
+  int freePassers = 0;
+  for (uint64_t passers = pawns.passedPawns[0] & (empty >> 8); passers;
+       passers &= passers - 1) {
+    freePassers += FREE_PASSER[__builtin_ctzll(passers) / 8];
+  }
+  for (uint64_t passers = pawns.passedPawns[1] & (empty << 8); passers;
+       passers &= passers - 1) {
+    freePassers -= FREE_PASSER[7 - __builtin_ctzll(passers) / 8];
+  }
+  packed += makeScore(0, freePassers);
+
+  // blend the midgame and endgame halves by how much material is left
+  int phase = std::min(board.getPhase(), MAX_PHASE);
+  int score = (mgScore(packed) * phase +
+               egScore(packed) * (MAX_PHASE - phase)) /
+              MAX_PHASE;
+
+  return board.sideToMove ? -score : score;
+}
@@ -0,0 +1,30 @@
+#ifndef EVALUATION_H
+#define EVALUATION_H
+
+#include "../chess_board/chess_board.h"
+#include "../nnue/nnue.h"
+#include "../pawn_table/pawn_table.h"
+
+/**
+ * Material value of each piece in centipawns, indexed by Piece value.
+ * Used for exchange decisions; the evaluation has its own tapered values.
+ */
+extern const int PIECE_VALUES[15];
+
+/**
+ * Evaluates a position statically. Given accumulators with a network this
+ * runs the network on the top accumulator. Otherwise it uses
+ * tapered material and piece-square tables plus pawn structure: the board
+ * keeps the material score up to date as moves are made and the pawn terms
+ * come from the pawn table, so this mostly interpolates between midgame
+ * and endgame halves.
+ *
+ * @param board Position to evaluate
+ * @param pawnTable Pawn structure cache of the calling thread
+ * @param nnue Accumulators kept in step with the board, or nullptr
+ * @return Score in centipawns from the side to move's point of view
+ */
+int evaluate(const ChessBoard &board, PawnTable &pawnTable,
+             const AccumulatorStack *nnue = nullptr);
+
+#endif
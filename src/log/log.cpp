@@ -0,0 +1,49 @@
+#include "log.h"
+#include <atomic>
+#include <cstdarg>
+#include <cstdio>
+
+static std::atomic<LogHandler> HANDLER(nullptr);
+static std::atomic<LogLevel> MINIMUM_LEVEL(LogLevel::Info);
+
+void setLogHandler(LogHandler handler, LogLevel minimum) {
+  MINIMUM_LEVEL.store(minimum, std::memory_order_relaxed);
+  HANDLER.store(handler, std::memory_order_release);
+}
+
+bool logEnabled(LogLevel level) {
+  return HANDLER.load(std::memory_order_relaxed) &&
+         level >= MINIMUM_LEVEL.load(std::memory_order_relaxed);
+}
+
+void logMessage(LogLevel level, const char *format, ...) {
+  LogHandler handler = HANDLER.load(std::memory_order_acquire);
+  if (!handler) {
+    return;
+  }
+
+  char message[256];
+  va_list args;
+  va_start(args, format);
+  std::vsnprintf(message, sizeof(message), format, args);
+  va_end(args);
+  handler(level, message);
+}
+
+void logToStderr(LogLevel level, const char *message) {
+  std::fprintf(stderr, "[%s] %s\n", logLevelName(level), message);
+}
+
+const char *logLevelName(LogLevel level) {
+  switch (level) {
+  case LogLevel::Debug:
+    return "debug";
+  case LogLevel::Info:
+    return "info";
+  case LogLevel::Warning:
+    return "warning";
+  case LogLevel::Error:
+    return "error";
+  }
+  return "unknown";
+}
@@ -0,0 +1,61 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <cstdint>
+
+/**
+ * Diagnostics hook for the library code (board, magics, network).
+ *
+ * Nothing is printed unless the application installs a handler, so the
+ * library never writes to stdout on its own; a UCI engine or a batch job
+ * decides where messages go. Building with -DNO_LOGGING (make LOGGING=0)
+ * removes every LOG statement at compile time, arguments included.
+ */
+
+enum class LogLevel : uint8_t { Debug, Info, Warning, Error };
+
+/**
+ * Receives one formatted message, without a trailing newline.
+ */
+using LogHandler = void (*)(LogLevel level, const char *message);
+
+/**
+ * Installs the function that receives log messages.
+ *
+ * @param handler Handler, or nullptr to drop all messages (the default)
+ * @param minimum Least severe level passed to the handler
+ */
+void setLogHandler(LogHandler handler, LogLevel minimum = LogLevel::Info);
+
+/**
+ * Checks if messages of a level would reach a handler.
+ */
+bool logEnabled(LogLevel level);
+
+/**
+ * Formats a message printf style and hands it to the handler. Messages
+ * longer than 255 characters are truncated.
+ */
+void logMessage(LogLevel level, const char *format, ...)
+    __attribute__((format(printf, 2, 3)));
+
+/**
+ * Ready-made handler writing "[level] message" lines to stderr.
+ */
+void logToStderr(LogLevel level, const char *message);
+
+const char *logLevelName(LogLevel level);
+
+#if defined(NO_LOGGING)
+#define LOG(level, ...) ((void)0)
+#else
+/// Formats only if the message will be used
+#define LOG(level, ...)                                                        \
+  do {                                                                         \
+    if (logEnabled(LogLevel::level)) {                                         \
+      logMessage(LogLevel::level, __VA_ARGS__);                                \
+    }                                                                          \
+  } while (0)
+#endif
+
+#endif
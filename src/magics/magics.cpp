@@ -1,6 +1,8 @@
 #include "magics.h"
+#include "../log/log.h"
+#include <atomic>
 #include <cstdint>
-#include <iostream>
+#include <mutex>
 #include <sys/types.h>
 
 uint64_t BISHOP_MAGICS[64] = {
@@ -17,7 +19,7 @@ uint64_t BISHOP_MAGICS[64] = {
     0xe4004081011002ULL,   0x1c004001012080ULL,   0x8004200962a00220ULL,
     0x8422100208500202ULL, 0x2000402200300c08ULL, 0x8646020080080080ULL,
     0x80020a0200100808ULL, 0x2010004880111000ULL, 0x623000a080011400ULL,
-    0x42008c03402092ULL,   0x209188240001000ULL,  0x400408a884001800ULL,
+    0x184008028020101ULL,  0x209188240001000ULL,  0x400408a884001800ULL,
     0x110400a6080400ULL,   0x1840060a44020800ULL, 0x90080104000041ULL,
     0x201011000808101ULL,  0x1a2208080504f080ULL, 0x8012020600211212ULL,
     0x500861011240000ULL,  0x180806108200800ULL,  0x4000020e01040044ULL,
@@ -51,14 +53,16 @@ uint64_t ROOK_MAGICS[64] = {
     0x20030a0244872ULL,    0x12001008414402ULL,   0x2006104900a0804ULL,
     0x1004081002402ULL};
 
-uint64_t ROOK_ATTACKS[64][4096];
-uint64_t BISHOP_ATTACKS[64][4096];
+uint64_t SLIDING_ATTACKS[ROOK_ATTACK_ENTRIES + BISHOP_ATTACK_ENTRIES];
 
-struct Magic {
-  uint64_t mask;
-  uint64_t magic;
-  int shift;
-};
+Magic ROOK_MAGIC_TABLE[64];
+Magic BISHOP_MAGIC_TABLE[64];
+
+/// Backend whose index order the tables currently hold
+static SlidingBackend activeBackend = SLIDING_BACKEND;
+
+/// Set once the attack tables have been built for some backend
+static std::atomic<bool> MAGICS_READY(false);
 
 static uint64_t generateSlidingAttacks(int square, uint64_t blockers,
                                        bool isBishop) {
@@ -98,10 +102,6 @@ uint64_t getQueenMask(int square) {
   return getBishopMask(square) | getRookMask(square);
 }
 
-uint64_t getQueenAttacks(int square, uint64_t blockers) {
-  return getBishopAttacks(square, blockers) | getRookAttacks(square, blockers);
-}
-
 uint64_t getBishopMask(int square) {
   uint64_t mask = 0;
   int rank = square / 8;
@@ -113,7 +113,7 @@ uint64_t getBishopMask(int square) {
   int f = file;
 
   // northeast
-  while (r < 6 && f < 7) {
+  while (r < 6 && f < 6) {
     r++;
     f++;
     mask |= 1ULL << (r * 8 + f);
@@ -123,7 +123,7 @@ uint64_t getBishopMask(int square) {
   f = file;
 
   // northwest
-  while (r < 6 && f > 0) {
+  while (r < 6 && f > 1) {
     r++;
     f--;
     mask |= 1ULL << (r * 8 + f);
@@ -133,7 +133,7 @@ uint64_t getBishopMask(int square) {
   f = file;
 
   // southeast
-  while (r > 1 && f < 7) {
+  while (r > 1 && f < 6) {
     r--;
     f++;
     mask |= 1ULL << (r * 8 + f);
@@ -143,7 +143,7 @@ uint64_t getBishopMask(int square) {
   f = file;
 
   // southwest
-  while (r > 1 && f > 0) {
+  while (r > 1 && f > 1) {
     r--;
     f--;
     mask |= 1ULL << (r * 8 + f);
@@ -152,17 +152,6 @@ uint64_t getBishopMask(int square) {
   return mask;
 }
 
-uint64_t getBishopAttacks(int square, uint64_t blockers) {
-  uint64_t mask = getBishopMask(square);
-  uint64_t relevantBlockers = blockers & mask;
-  uint64_t magic = BISHOP_MAGICS[square];
-
-  int shift = 64 - __builtin_popcountll(mask);
-  int index = (relevantBlockers * magic) >> shift;
-
-  return BISHOP_ATTACKS[square][index];
-}
-
 uint64_t getRookMask(int square) {
   int rank = square / 8;
   int file = square % 8;
@@ -188,28 +177,23 @@ uint64_t getRookMask(int square) {
   return mask;
 }
 
-uint64_t getRookAttacks(int square, uint64_t blockers) {
-  uint64_t mask = getRookMask(square);
-  uint64_t relevantBlockers = blockers & mask;
-  uint64_t magic = ROOK_MAGICS[square];
-
-  int shift = 64 - __builtin_popcountll(mask);
-  int index = (blockers * magic) >> shift;
-
-  return ROOK_ATTACKS[square][index];
-};
-
-void initMagicTable(bool isBishop) {
+void initMagicTable(bool isBishop, SlidingBackend backend) {
   uint64_t *magics = isBishop ? BISHOP_MAGICS : ROOK_MAGICS;
-  uint64_t(*attacks)[4096] = isBishop ? BISHOP_ATTACKS : ROOK_ATTACKS;
-
-  std::cout << "Initializing " << (isBishop ? "bishop" : "rook") << " magics\n";
+  Magic *table = isBishop ? BISHOP_MAGIC_TABLE : ROOK_MAGIC_TABLE;
+  uint32_t offset = isBishop ? ROOK_ATTACK_ENTRIES : 0;
 
   for (int square = 0; square < 64; square++) {
     uint64_t mask = isBishop ? getBishopMask(square) : getRookMask(square);
     int bits = __builtin_popcountll(mask);
     int n = 1 << bits;
 
+    Magic &entry = table[square];
+    entry.mask = mask;
+    entry.magic = magics[square];
+    entry.shift = 64 - bits;
+    entry.offset = offset;
+    offset += n;
+
     // Generate all possible blocker combinations for this square
     for (int i = 0; i < n; i++) {
       uint64_t blockers = 0;
@@ -226,23 +210,97 @@ void initMagicTable(bool isBishop) {
         j++;
       }
 
-      // Calculate magic index
-      uint64_t magic = magics[square];
-      int shift = 64 - bits;
-      int index = (blockers * magic) >> shift;
+      // Calculate magic or PEXT index, whichever backend is requested
+      uint64_t index =
+          backend == SlidingBackend::Pext
+              ? slidingIndex<SlidingBackend::Pext>(entry, blockers)
+              : slidingIndex<SlidingBackend::Magic>(entry, blockers);
 
       // Store attack pattern
       uint64_t attack = generateSlidingAttacks(square, blockers, isBishop);
-      attacks[square][index] = attack;
+      SLIDING_ATTACKS[entry.offset + index] = attack;
     }
   }
-  std::cout << "Finished initializing " << (isBishop ? "bishop" : "rook")
-            << " magics\n";
+  LOG(Debug, "Initialized %s attacks", isBishop ? "bishop" : "rook");
+}
+
+bool cpuHasFastPext() {
+#if defined(__x86_64__) && defined(__GNUC__)
+  // Zen 1/2 implement PEXT in microcode, far slower than a magic multiply
+  return __builtin_cpu_supports("bmi2") && !__builtin_cpu_is("znver1") &&
+         !__builtin_cpu_is("znver2");
+#else
+  return false;
+#endif
+}
+
+SlidingBackend getSlidingBackend() { return activeBackend; }
+
+const char *slidingBackendName(SlidingBackend backend) {
+  return backend == SlidingBackend::Pext ? "pext" : "magic";
 }
 
-void initMagics() {
-  std::cout << "Initializing magics" << std::endl;
+void initMagics() { initMagics(SLIDING_BACKEND); }
+
+void initMagics(SlidingBackend backend) {
+  if (!PEXT_BUILD) {
+    backend = SlidingBackend::Magic;
+  }
+  activeBackend = backend;
+
+  LOG(Debug, "Initializing sliding attacks (%s)", slidingBackendName(backend));
   // init both rook and bishop magics (attack tables)
-  initMagicTable(true);  // bishops
-  initMagicTable(false); // rooks
+  initMagicTable(true, backend);  // bishops
+  initMagicTable(false, backend); // rooks
+  MAGICS_READY = true;
+}
+
+void ensureMagics() {
+  static std::mutex mutex;
+  if (MAGICS_READY) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(mutex);
+  if (!MAGICS_READY) {
+    initMagics();
+  }
+}
+
+/**
+ * Looks up rook or bishop attacks with a given backend.
+ */
+template <SlidingBackend Backend>
+static uint64_t lookupAttacks(bool isBishop, int square, uint64_t blockers) {
+  return isBishop ? getBishopAttacks<Backend>(square, blockers)
+                  : getRookAttacks<Backend>(square, blockers);
+}
+
+bool verifyMagics() {
+  for (int isBishop = 0; isBishop < 2; isBishop++) {
+    const Magic *table = isBishop ? BISHOP_MAGIC_TABLE : ROOK_MAGIC_TABLE;
+
+    for (int square = 0; square < 64; square++) {
+      uint64_t mask = table[square].mask;
+
+      // Walk every subset of the mask (carry-rippler), starting from empty
+      uint64_t blockers = 0;
+      do {
+        uint64_t expected = generateSlidingAttacks(square, blockers, isBishop);
+        uint64_t actual =
+            activeBackend == SlidingBackend::Pext
+                ? lookupAttacks<SlidingBackend::Pext>(isBishop, square,
+                                                      blockers)
+                : lookupAttacks<SlidingBackend::Magic>(isBishop, square,
+                                                       blockers);
+        if (actual != expected) {
+          LOG(Error, "%s attacks wrong on square %d",
+              isBishop ? "Bishop" : "Rook", square);
+          return false;
+        }
+        blockers = (blockers - mask) & mask;
+      } while (blockers);
+    }
+  }
+
+  return true;
 }
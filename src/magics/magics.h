@@ -3,19 +3,146 @@
 
 #include <cstdint>
 
-void initMagicTable(bool isBishop);
+#if defined(USE_PEXT)
+#include <immintrin.h>
+#endif
+
+/*
+ * Per-square lookup record into SLIDING_ATTACKS.
+ */
+struct Magic {
+  uint64_t mask;   /// Relevant blocker squares
+  uint64_t magic;  /// Multiplier mapping blockers to an index
+  uint32_t shift;  /// 64 - number of relevant bits
+  uint32_t offset; /// Start of this square's slice of SLIDING_ATTACKS
+};
+
+// Each square only needs 2^(relevant bits) entries, so rook and bishop attacks
+// share one densely packed table: rooks first, then bishops
+const int ROOK_ATTACK_ENTRIES = 102400;
+const int BISHOP_ATTACK_ENTRIES = 5248;
+
+extern uint64_t SLIDING_ATTACKS[ROOK_ATTACK_ENTRIES + BISHOP_ATTACK_ENTRIES];
+extern Magic ROOK_MAGIC_TABLE[64];
+extern Magic BISHOP_MAGIC_TABLE[64];
+
+/**
+ * How sliding attack indices are computed.
+ *
+ * Both backends share SLIDING_ATTACKS and its per-square slices; only the
+ * order of entries inside a slice differs, so the table is filled for one
+ * backend at a time.
+ *
+ * The backend of the engine's lookups is fixed at compile time, so the hot
+ * path never tests a flag (make PEXT=...):
+ * - unset: magic multiplication; PEXT can still be benchmarked on BMI2 CPUs
+ * - 1:     PEXT, compiled with -mbmi2 (requires BMI2 hardware)
+ * - 0:     magic multiplication only, no PEXT code at all
+ */
+enum class SlidingBackend : uint8_t { Magic, Pext };
+
+#if defined(USE_PEXT)
+inline constexpr SlidingBackend SLIDING_BACKEND = SlidingBackend::Pext;
+#else
+inline constexpr SlidingBackend SLIDING_BACKEND = SlidingBackend::Magic;
+#endif
+
+/// Whether this build can run PEXT lookups at all
+#if defined(USE_PEXT) || (!defined(NO_PEXT) && defined(__x86_64__))
+inline constexpr bool PEXT_BUILD = true;
+#else
+inline constexpr bool PEXT_BUILD = false;
+#endif
 
+/**
+ * Fills one piece's part of the attack table.
+ *
+ * @param isBishop true for bishops, false for rooks
+ * @param backend Backend whose index order to use
+ */
+void initMagicTable(bool isBishop, SlidingBackend backend = SLIDING_BACKEND);
+
+/**
+ * Initializes the sliding attack tables for the build's backend.
+ */
 void initMagics();
-static uint64_t generateSlidingAttacks(int square, int bits, int *directions,
-                                       uint64_t *mask, uint64_t *attacks);
 
-uint64_t getBishopMask(int square);
-uint64_t getBishopAttacks(int square, uint64_t block);
+/**
+ * Initializes the sliding attack tables for a specific backend, e.g. to
+ * benchmark it. Falls back to magics when the build cannot use PEXT.
+ * Only lookups instantiated for that backend are valid until initMagics()
+ * restores the build's backend.
+ *
+ * @param backend Backend to build the tables for
+ */
+void initMagics(SlidingBackend backend);
 
-uint64_t getRookMask(int square);
-uint64_t getRookAttacks(int square, uint64_t block);
+/**
+ * Initializes the sliding attack tables unless that was already done, so
+ * every board can call it cheaply. Thread-safe.
+ */
+void ensureMagics();
 
+/**
+ * Checks if this CPU has a PEXT instruction worth using.
+ */
+bool cpuHasFastPext();
+
+/**
+ * Gets the backend the tables are currently built for.
+ */
+SlidingBackend getSlidingBackend();
+
+const char *slidingBackendName(SlidingBackend backend);
+
+/**
+ * Checks every blocker subset of every square against a ray-walking
+ * reference implementation.
+ *
+ * @return true if all rook and bishop lookups are correct
+ */
+bool verifyMagics();
+
+uint64_t getBishopMask(int square);
+uint64_t getRookMask(int square);
 uint64_t getQueenMask(int square);
-uint64_t getQueenAttacks(int square, uint64_t block);
+
+/**
+ * Maps the blockers on a square's rays to an index in its attack slice.
+ * Magic: one AND, one multiply and one shift. PEXT: a single instruction.
+ */
+template <SlidingBackend Backend = SLIDING_BACKEND>
+inline uint64_t slidingIndex(const Magic &entry, uint64_t blockers) {
+  if constexpr (Backend == SlidingBackend::Pext) {
+#if defined(USE_PEXT)
+    return _pext_u64(blockers, entry.mask);
+#elif !defined(NO_PEXT) && defined(__x86_64__)
+    // inline asm needs no -mbmi2; callers only use it once CPUID has
+    // confirmed BMI2
+    uint64_t index;
+    asm("pextq %2, %1, %0" : "=r"(index) : "r"(blockers), "rm"(entry.mask));
+    return index;
+#endif
+  }
+  return ((blockers & entry.mask) * entry.magic) >> entry.shift;
+}
+
+template <SlidingBackend Backend = SLIDING_BACKEND>
+inline uint64_t getBishopAttacks(int square, uint64_t blockers) {
+  const Magic &entry = BISHOP_MAGIC_TABLE[square];
+  return SLIDING_ATTACKS[entry.offset + slidingIndex<Backend>(entry, blockers)];
+}
+
+template <SlidingBackend Backend = SLIDING_BACKEND>
+inline uint64_t getRookAttacks(int square, uint64_t blockers) {
+  const Magic &entry = ROOK_MAGIC_TABLE[square];
+  return SLIDING_ATTACKS[entry.offset + slidingIndex<Backend>(entry, blockers)];
+}
+
+template <SlidingBackend Backend = SLIDING_BACKEND>
+inline uint64_t getQueenAttacks(int square, uint64_t blockers) {
+  return getBishopAttacks<Backend>(square, blockers) |
+         getRookAttacks<Backend>(square, blockers);
+}
 
 #endif
@@ -0,0 +1,190 @@
+#include "move_picker.h"
+#include "../evaluation/evaluation.h"
+#include "../see/see.h"
+#include <utility>
+
+MovePicker::MovePicker(const ChessBoard &board, Move ttMove,
+                       const Move killers[2], Move counterMove,
+                       const int (*history)[64])
+    : board(board), ttMove(ttMove), killers{killers[0], killers[1]},
+      counterMove(counterMove), history(history), skipQuiets(false),
+      evasions(false), stage(Stage::HashMove), current(0), currentBad(0) {}
+
+MovePicker::MovePicker(const ChessBoard &board, Move ttMove,
+                       const int (*history)[64])
+    : board(board), ttMove(ttMove), killers{Move::none(), Move::none()},
+      counterMove(Move::none()), history(history), skipQuiets(false),
+      evasions(board.inCheck()), stage(Stage::HashMove), current(0),
+      currentBad(0) {
+  skipQuiets = !evasions;
+  if (skipQuiets && !ttMove.isCapture() && !ttMove.isPromotion()) {
+    this->ttMove = Move::none();
+  }
+}
+
+void MovePicker::scoreCaptures() {
+  for (int i = 0; i < moves.size(); i++) {
+    Move move = moves[i];
+
+    // Most valuable victim first, least valuable attacker breaks ties
+    Piece victim = move.isEnPassant() ? Piece::WhitePawn
+                                      : board.getPiece(move.to());
+    Piece attacker = board.getPiece(move.from());
+    scores[i] = PIECE_VALUES[uint8_t(victim)] * 10 -
+                PIECE_VALUES[uint8_t(attacker)] / 10;
+    if (move.isPromotion()) {
+      scores[i] +=
+          PIECE_VALUES[uint8_t(Piece::WhiteKnight) + (move.flags() & 3)];
+    }
+  }
+}
+
+void MovePicker::scoreQuiets() {
+  for (int i = 0; i < moves.size(); i++) {
+    scores[i] = history[moves[i].from()][moves[i].to()];
+  }
+}
+
+void MovePicker::scoreEvasions() {
+  // Capturing the checker usually beats running or blocking
+  for (int i = 0; i < moves.size(); i++) {
+    Move move = moves[i];
+    if (move.isCapture()) {
+      Piece victim = move.isEnPassant() ? Piece::WhitePawn
+                                        : board.getPiece(move.to());
+      scores[i] = (1 << 20) + PIECE_VALUES[uint8_t(victim)] * 10 -
+                  PIECE_VALUES[uint8_t(board.getPiece(move.from()))] / 10;
+    } else {
+      scores[i] = history[move.from()][move.to()];
+    }
+  }
+}
+
+Move MovePicker::pickBest() {
+  int best = current;
+  for (int i = current + 1; i < moves.size(); i++) {
+    if (scores[i] > scores[best]) {
+      best = i;
+    }
+  }
+
+  std::swap(moves[current], moves[best]);
+  std::swap(scores[current], scores[best]);
+  return moves[current++];
+}
+
+bool MovePicker::alreadyPicked(Move move) const {
+  return move == ttMove || move == killers[0] || move == killers[1] ||
+         move == counterMove;
+}
+
+Move MovePicker::next() {
+  switch (stage) {
+  case Stage::HashMove:
+    stage = evasions ? Stage::GenerateEvasions : Stage::GenerateCaptures;
+    if (board.isLegal(ttMove)) {
+      return ttMove;
+    }
+    ttMove = Move::none();
+    return next();
+
+  case Stage::GenerateCaptures:
+    board.generateCaptures(moves);
+    scoreCaptures();
+    current = 0;
+    stage = Stage::Captures;
+    [[fallthrough]];
+
+  case Stage::Captures:
+    while (current < moves.size()) {
+      Move move = pickBest();
+      if (move == ttMove) {
+        continue;
+      }
+      if (!seeGreaterOrEqual(board, move, 0)) {
+        badCaptures.push_back(move);
+        continue;
+      }
+      return move;
+    }
+    stage = skipQuiets ? Stage::Done : Stage::FirstKiller;
+    if (skipQuiets) {
+      return Move::none();
+    }
+    [[fallthrough]];
+
+  // Killers and the counter move are only valid while they are quiet, which
+  // isLegal checks through the flags
+  case Stage::FirstKiller:
+    stage = Stage::SecondKiller;
+    if (killers[0] != ttMove && board.isLegal(killers[0])) {
+      return killers[0];
+    }
+    killers[0] = Move::none();
+    [[fallthrough]];
+
+  case Stage::SecondKiller:
+    stage = Stage::CounterMove;
+    if (killers[1] != ttMove && killers[1] != killers[0] &&
+        board.isLegal(killers[1])) {
+      return killers[1];
+    }
+    killers[1] = Move::none();
+    [[fallthrough]];
+
+  case Stage::CounterMove:
+    stage = Stage::GenerateQuiets;
+    if (counterMove != ttMove && counterMove != killers[0] &&
+        counterMove != killers[1] && board.isLegal(counterMove)) {
+      return counterMove;
+    }
+    counterMove = Move::none();
+    [[fallthrough]];
+
+  case Stage::GenerateQuiets:
+    board.generateQuiets(moves);
+    scoreQuiets();
+    current = 0;
+    stage = Stage::Quiets;
+    [[fallthrough]];
+
+  case Stage::Quiets:
+    while (current < moves.size()) {
+      Move move = pickBest();
+      if (!alreadyPicked(move)) {
+        return move;
+      }
+    }
+    stage = Stage::BadCaptures;
+    [[fallthrough]];
+
+  case Stage::BadCaptures:
+    if (currentBad < badCaptures.size()) {
+      return badCaptures[currentBad++];
+    }
+    stage = Stage::Done;
+    return Move::none();
+
+  case Stage::GenerateEvasions:
+    board.generate<GenType::Evasions>(moves);
+    scoreEvasions();
+    current = 0;
+    stage = Stage::Evasions;
+    [[fallthrough]];
+
+  case Stage::Evasions:
+    while (current < moves.size()) {
+      Move move = pickBest();
+      if (move != ttMove) {
+        return move;
+      }
+    }
+    stage = Stage::Done;
+    [[fallthrough]];
+
+  case Stage::Done:
+    return Move::none();
+  }
+
+  return Move::none();
+}
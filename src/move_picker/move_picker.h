@@ -0,0 +1,96 @@
+#ifndef MOVE_PICKER_H
+#define MOVE_PICKER_H
+
+#include "../chess_board/chess_board.h"
+#include <cstdint>
+
+/**
+ * Hands out the legal moves of a position one at a time, most promising
+ * first, generating each group of moves only once the previous group is
+ * used up.
+ *
+ * Order: hash move, winning and equal captures and promotions by MVV-LVA,
+ * the two killer moves, the counter move, the remaining quiet moves by
+ * history score, and last the captures that lose material by SEE.
+ * Most cut nodes fail high on one of the first moves, so the quiet moves
+ * are often never generated or sorted at all.
+ */
+class MovePicker {
+public:
+  /**
+   * Picks from all moves, for the main search.
+   *
+   * @param board Position to pick moves in; must outlive the picker
+   * @param ttMove Move from the transposition table, or Move::none()
+   * @param killers Two quiet moves that recently cut off at this ply
+   * @param counterMove Quiet move that last refuted the previous move
+   * @param history History scores of the side to move, by from and to
+   */
+  MovePicker(const ChessBoard &board, Move ttMove, const Move killers[2],
+             Move counterMove, const int (*history)[64]);
+
+  /**
+   * Picks captures and promotions that do not lose material, for
+   * quiescence search. When in check, all evasions are generated at once and
+   * picked instead.
+   *
+   * @param board Position to pick moves in; must outlive the picker
+   * @param ttMove Move from the transposition table, or Move::none()
+   * @param history History scores of the side to move, by from and to
+   */
+  MovePicker(const ChessBoard &board, Move ttMove, const int (*history)[64]);
+
+  /**
+   * Gets the next move.
+   * @return Next legal move, or Move::none() when all have been picked
+   */
+  Move next();
+
+private:
+  enum class Stage : uint8_t {
+    HashMove,
+    GenerateCaptures,
+    Captures,
+    FirstKiller,
+    SecondKiller,
+    CounterMove,
+    GenerateQuiets,
+    Quiets,
+    BadCaptures,
+    GenerateEvasions,
+    Evasions,
+    Done
+  };
+
+  const ChessBoard &board;
+  Move ttMove;
+  Move killers[2];
+  Move counterMove;
+  const int (*history)[64];
+  bool skipQuiets;
+  bool evasions;
+  Stage stage;
+
+  MoveList moves;
+  int scores[MoveList::CAPACITY];
+  int current;
+
+  MoveList badCaptures; /// Captures losing material, tried last
+  int currentBad;
+
+  void scoreCaptures();
+  void scoreQuiets();
+  void scoreEvasions();
+
+  /**
+   * Moves the best scored remaining move to the front and returns it.
+   */
+  Move pickBest();
+
+  /**
+   * Checks if a move was already handed out by an earlier stage.
+   */
+  bool alreadyPicked(Move move) const;
+};
+
+#endif
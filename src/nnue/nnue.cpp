@@ -0,0 +1,488 @@
+#include "nnue.h"
+#include "../log/log.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define NNUE_MMAP
+#endif
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define NNUE_X86
+#endif
+
+static SimdBackend backend = cpuSimdBackend();
+
+SimdBackend cpuSimdBackend() {
+#ifdef NNUE_X86
+  // also runs from a static initializer, before GCC has probed the CPU
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    return SimdBackend::Avx2;
+  if (__builtin_cpu_supports("sse4.1"))
+    return SimdBackend::Sse41;
+#endif
+  return SimdBackend::Scalar;
+}
+
+void setSimdBackend(SimdBackend requested) {
+  backend = std::min(requested, cpuSimdBackend());
+}
+
+SimdBackend getSimdBackend() { return backend; }
+
+const char *simdBackendName(SimdBackend backend) {
+  switch (backend) {
+  case SimdBackend::Avx2:
+    return "avx2";
+  case SimdBackend::Sse41:
+    return "sse4.1";
+  default:
+    return "scalar";
+  }
+}
+
+// Kernels. Each backend computes exactly the same integers: int16 adds
+// wrap the same way, and maddubs cannot saturate on inputs <= 127.
+
+static void updateScalar(const int16_t *previous, const int16_t *const *added,
+                         int addedCount, const int16_t *const *removed,
+                         int removedCount, int16_t *out) {
+  for (int i = 0; i < NNUE_HIDDEN; i++) {
+    int16_t value = previous[i];
+    for (int a = 0; a < addedCount; a++)
+      value += added[a][i];
+    for (int r = 0; r < removedCount; r++)
+      value -= removed[r][i];
+    out[i] = value;
+  }
+}
+
+static void clipScalar(const int16_t *in, uint8_t *out) {
+  for (int i = 0; i < NNUE_HIDDEN; i++) {
+    out[i] = std::clamp<int>(in[i], 0, 127);
+  }
+}
+
+static int32_t dotScalar(const uint8_t *in, const int8_t *weights, int dims) {
+  int32_t sum = 0;
+  for (int i = 0; i < dims; i++) {
+    sum += in[i] * weights[i];
+  }
+  return sum;
+}
+
+static void affineScalar(const uint8_t *in, int inDims, const int8_t *weights,
+                         const int32_t *biases, int outDims, int32_t *out) {
+  for (int j = 0; j < outDims; j++) {
+    out[j] = biases[j] + dotScalar(in, weights + j * inDims, inDims);
+  }
+}
+
+#ifdef NNUE_X86
+__attribute__((target("avx2"))) static void
+updateAvx2(const int16_t *previous, const int16_t *const *added,
+           int addedCount, const int16_t *const *removed, int removedCount,
+           int16_t *out) {
+  for (int i = 0; i < NNUE_HIDDEN; i += 16) {
+    __m256i value = _mm256_loadu_si256((const __m256i *)(previous + i));
+    for (int a = 0; a < addedCount; a++)
+      value = _mm256_add_epi16(
+          value, _mm256_loadu_si256((const __m256i *)(added[a] + i)));
+    for (int r = 0; r < removedCount; r++)
+      value = _mm256_sub_epi16(
+          value, _mm256_loadu_si256((const __m256i *)(removed[r] + i)));
+    _mm256_storeu_si256((__m256i *)(out + i), value);
+  }
+}
+
+__attribute__((target("avx2"))) static void clipAvx2(const int16_t *in,
+                                                     uint8_t *out) {
+  for (int i = 0; i < NNUE_HIDDEN; i += 32) {
+    __m256i low = _mm256_loadu_si256((const __m256i *)(in + i));
+    __m256i high = _mm256_loadu_si256((const __m256i *)(in + i + 16));
+    // packs saturates to 127 and interleaves the 128-bit lanes
+    __m256i packed = _mm256_packs_epi16(low, high);
+    packed = _mm256_max_epi8(packed, _mm256_setzero_si256());
+    packed = _mm256_permute4x64_epi64(packed, 0xD8);
+    _mm256_storeu_si256((__m256i *)(out + i), packed);
+  }
+}
+
+__attribute__((target("avx2"))) static int32_t
+dotAvx2(const uint8_t *in, const int8_t *weights, int dims) {
+  const __m256i ones = _mm256_set1_epi16(1);
+  __m256i sum = _mm256_setzero_si256();
+  for (int i = 0; i < dims; i += 32) {
+    __m256i products = _mm256_maddubs_epi16(
+        _mm256_loadu_si256((const __m256i *)(in + i)),
+        _mm256_loadu_si256((const __m256i *)(weights + i)));
+    sum = _mm256_add_epi32(sum, _mm256_madd_epi16(products, ones));
+  }
+  __m128i total = _mm_add_epi32(_mm256_castsi256_si128(sum),
+                                _mm256_extracti128_si256(sum, 1));
+  total = _mm_add_epi32(total, _mm_shuffle_epi32(total, 0x4E));
+  total = _mm_add_epi32(total, _mm_shuffle_epi32(total, 0xB1));
+  return _mm_cvtsi128_si32(total);
+}
+
+// Four rows at a time share the input loads and one horizontal reduction
+__attribute__((target("avx2"))) static void
+affineAvx2(const uint8_t *in, int inDims, const int8_t *weights,
+           const int32_t *biases, int outDims, int32_t *out) {
+  const __m256i ones = _mm256_set1_epi16(1);
+  for (int j = 0; j < outDims; j += 4) {
+    const int8_t *row = weights + j * inDims;
+    __m256i sums[4] = {_mm256_setzero_si256(), _mm256_setzero_si256(),
+                       _mm256_setzero_si256(), _mm256_setzero_si256()};
+    for (int i = 0; i < inDims; i += 32) {
+      __m256i input = _mm256_loadu_si256((const __m256i *)(in + i));
+      for (int r = 0; r < 4; r++) {
+        __m256i products = _mm256_maddubs_epi16(
+            input,
+            _mm256_loadu_si256((const __m256i *)(row + r * inDims + i)));
+        sums[r] = _mm256_add_epi32(sums[r], _mm256_madd_epi16(products, ones));
+      }
+    }
+    __m256i pairs = _mm256_hadd_epi32(_mm256_hadd_epi32(sums[0], sums[1]),
+                                      _mm256_hadd_epi32(sums[2], sums[3]));
+    __m128i total = _mm_add_epi32(_mm256_castsi256_si128(pairs),
+                                  _mm256_extracti128_si256(pairs, 1));
+    total = _mm_add_epi32(total,
+                          _mm_loadu_si128((const __m128i *)(biases + j)));
+    _mm_storeu_si128((__m128i *)(out + j), total);
+  }
+}
+
+__attribute__((target("sse4.1"))) static void
+updateSse41(const int16_t *previous, const int16_t *const *added,
+            int addedCount, const int16_t *const *removed, int removedCount,
+            int16_t *out) {
+  for (int i = 0; i < NNUE_HIDDEN; i += 8) {
+    __m128i value = _mm_loadu_si128((const __m128i *)(previous + i));
+    for (int a = 0; a < addedCount; a++)
+      value = _mm_add_epi16(value,
+                            _mm_loadu_si128((const __m128i *)(added[a] + i)));
+    for (int r = 0; r < removedCount; r++)
+      value = _mm_sub_epi16(
+          value, _mm_loadu_si128((const __m128i *)(removed[r] + i)));
+    _mm_storeu_si128((__m128i *)(out + i), value);
+  }
+}
+
+__attribute__((target("sse4.1"))) static void clipSse41(const int16_t *in,
+                                                       uint8_t *out) {
+  for (int i = 0; i < NNUE_HIDDEN; i += 16) {
+    __m128i packed =
+        _mm_packs_epi16(_mm_loadu_si128((const __m128i *)(in + i)),
+                        _mm_loadu_si128((const __m128i *)(in + i + 8)));
+    packed = _mm_max_epi8(packed, _mm_setzero_si128());
+    _mm_storeu_si128((__m128i *)(out + i), packed);
+  }
+}
+
+__attribute__((target("sse4.1"))) static int32_t
+dotSse41(const uint8_t *in, const int8_t *weights, int dims) {
+  const __m128i ones = _mm_set1_epi16(1);
+  __m128i sum = _mm_setzero_si128();
+  for (int i = 0; i < dims; i += 16) {
+    __m128i products =
+        _mm_maddubs_epi16(_mm_loadu_si128((const __m128i *)(in + i)),
+                          _mm_loadu_si128((const __m128i *)(weights + i)));
+    sum = _mm_add_epi32(sum, _mm_madd_epi16(products, ones));
+  }
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E));
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xB1));
+  return _mm_cvtsi128_si32(sum);
+}
+__attribute__((target("sse4.1"))) static void
+affineSse41(const uint8_t *in, int inDims, const int8_t *weights,
+            const int32_t *biases, int outDims, int32_t *out) {
+  const __m128i ones = _mm_set1_epi16(1);
+  for (int j = 0; j < outDims; j += 4) {
+    const int8_t *row = weights + j * inDims;
+    __m128i sums[4] = {_mm_setzero_si128(), _mm_setzero_si128(),
+                       _mm_setzero_si128(), _mm_setzero_si128()};
+    for (int i = 0; i < inDims; i += 16) {
+      __m128i input = _mm_loadu_si128((const __m128i *)(in + i));
+      for (int r = 0; r < 4; r++) {
+        __m128i products = _mm_maddubs_epi16(
+            input, _mm_loadu_si128((const __m128i *)(row + r * inDims + i)));
+        sums[r] = _mm_add_epi32(sums[r], _mm_madd_epi16(products, ones));
+      }
+    }
+    __m128i total = _mm_hadd_epi32(_mm_hadd_epi32(sums[0], sums[1]),
+                                   _mm_hadd_epi32(sums[2], sums[3]));
+    total = _mm_add_epi32(total,
+                          _mm_loadu_si128((const __m128i *)(biases + j)));
+    _mm_storeu_si128((__m128i *)(out + j), total);
+  }
+}
+#endif
+
+static void updateKernel(const int16_t *previous, const int16_t *const *added,
+                         int addedCount, const int16_t *const *removed,
+                         int removedCount, int16_t *out) {
+#ifdef NNUE_X86
+  if (backend == SimdBackend::Avx2)
+    return updateAvx2(previous, added, addedCount, removed, removedCount,
+                      out);
+  if (backend == SimdBackend::Sse41)
+    return updateSse41(previous, added, addedCount, removed, removedCount,
+                       out);
+#endif
+  updateScalar(previous, added, addedCount, removed, removedCount, out);
+}
+
+static void clipKernel(const int16_t *in, uint8_t *out) {
+#ifdef NNUE_X86
+  if (backend == SimdBackend::Avx2)
+    return clipAvx2(in, out);
+  if (backend == SimdBackend::Sse41)
+    return clipSse41(in, out);
+#endif
+  clipScalar(in, out);
+}
+
+static int32_t dotKernel(const uint8_t *in, const int8_t *weights, int dims) {
+#ifdef NNUE_X86
+  if (backend == SimdBackend::Avx2)
+    return dotAvx2(in, weights, dims);
+  if (backend == SimdBackend::Sse41)
+    return dotSse41(in, weights, dims);
+#endif
+  return dotScalar(in, weights, dims);
+}
+
+/**
+ * Runs one hidden layer: affine transform, rescale and clip to [0, 127].
+ * The number of outputs must be a multiple of 4.
+ */
+static void hiddenLayer(const uint8_t *in, int inDims, const int8_t *weights,
+                        const int32_t *biases, int outDims, uint8_t *out) {
+  alignas(64) int32_t sums[NNUE_L1 > NNUE_L2 ? NNUE_L1 : NNUE_L2];
+#ifdef NNUE_X86
+  if (backend == SimdBackend::Avx2)
+    affineAvx2(in, inDims, weights, biases, outDims, sums);
+  else if (backend == SimdBackend::Sse41)
+    affineSse41(in, inDims, weights, biases, outDims, sums);
+  else
+#endif
+    affineScalar(in, inDims, weights, biases, outDims, sums);
+
+  for (int j = 0; j < outDims; j++) {
+    out[j] = std::clamp(sums[j] >> NNUE_WEIGHT_SHIFT, 0, 127);
+  }
+}
+
+Network::~Network() { release(); }
+
+void Network::release() {
+  if (data) {
+#ifdef NNUE_MMAP
+    if (mapped) {
+      munmap(const_cast<uint8_t *>(data), size);
+    } else
+#endif
+    {
+      delete[] data;
+    }
+  }
+  data = nullptr;
+  size = 0;
+  mapped = false;
+}
+
+bool Network::load(const std::string &path) {
+  release();
+
+  const size_t expected = nnueFileSize();
+#ifdef NNUE_MMAP
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    LOG(Warning, "Cannot open network file %s", path.c_str());
+    return false;
+  }
+  struct stat info;
+  void *map = MAP_FAILED;
+  if (fstat(fd, &info) == 0 && size_t(info.st_size) == expected) {
+    map = mmap(nullptr, expected, PROT_READ, MAP_PRIVATE, fd, 0);
+  }
+  close(fd);
+  if (map == MAP_FAILED) {
+    LOG(Warning, "%s is not a %zu byte network file", path.c_str(), expected);
+    return false;
+  }
+  data = static_cast<const uint8_t *>(map);
+  mapped = true;
+#else
+  std::ifstream file(path, std::ios::binary | std::ios::ate);
+  if (!file || size_t(file.tellg()) != expected) {
+    LOG(Warning, "%s is not a %zu byte network file", path.c_str(), expected);
+    return false;
+  }
+  uint8_t *buffer = new uint8_t[expected];
+  file.seekg(0);
+  file.read(reinterpret_cast<char *>(buffer), expected);
+  data = buffer;
+#endif
+  size = expected;
+
+  NnueHeader header;
+  std::memcpy(&header, data, sizeof(header));
+  if (std::memcmp(header.magic, "NNUE", 4) != 0 ||
+      header.version != NNUE_VERSION || header.features != NNUE_FEATURES ||
+      header.hidden != NNUE_HIDDEN) {
+    LOG(Warning, "%s has an incompatible header", path.c_str());
+    release();
+    return false;
+  }
+
+  // Sections follow each other as documented in NnueHeader; all of them
+  // start on a multiple of their element size
+  const uint8_t *cursor = data + sizeof(NnueHeader);
+  auto take = [&cursor](size_t bytes) {
+    const uint8_t *section = cursor;
+    cursor += bytes;
+    return section;
+  };
+  featureWeights = reinterpret_cast<const int16_t *>(
+      take(NNUE_FEATURES * NNUE_HIDDEN * 2));
+  featureBiases = reinterpret_cast<const int16_t *>(take(NNUE_HIDDEN * 2));
+  l1Weights = reinterpret_cast<const int8_t *>(take(NNUE_L1 * 2 * NNUE_HIDDEN));
+  l1Biases = reinterpret_cast<const int32_t *>(take(NNUE_L1 * 4));
+  l2Weights = reinterpret_cast<const int8_t *>(take(NNUE_L2 * NNUE_L1));
+  l2Biases = reinterpret_cast<const int32_t *>(take(NNUE_L2 * 4));
+  outputWeights = reinterpret_cast<const int8_t *>(take(NNUE_L2));
+  outputBias = reinterpret_cast<const int32_t *>(take(4));
+  return true;
+}
+
+void Network::refresh(const int *features, int count, int16_t *out) const {
+  // one feature per piece; extra ones would overrun the row list
+  const int16_t *rows[NNUE_MAX_PIECES];
+  count = std::min(count, NNUE_MAX_PIECES);
+  for (int i = 0; i < count; i++) {
+    rows[i] = featureWeights + features[i] * NNUE_HIDDEN;
+  }
+  updateKernel(featureBiases, rows, count, nullptr, 0, out);
+}
+
+void Network::update(const int16_t *previous, const int *added,
+                     int addedCount, const int *removed, int removedCount,
+                     int16_t *out) const {
+  const int16_t *addedRows[NNUE_MAX_CHANGES];
+  const int16_t *removedRows[NNUE_MAX_CHANGES];
+  for (int i = 0; i < addedCount; i++) {
+    addedRows[i] = featureWeights + added[i] * NNUE_HIDDEN;
+  }
+  for (int i = 0; i < removedCount; i++) {
+    removedRows[i] = featureWeights + removed[i] * NNUE_HIDDEN;
+  }
+  updateKernel(previous, addedRows, addedCount, removedRows, removedCount,
+               out);
+}
+
+int Network::evaluate(const Accumulator &accumulator, int side) const {
+  alignas(64) uint8_t input[2 * NNUE_HIDDEN];
+  alignas(64) uint8_t hidden1[NNUE_L1];
+  alignas(64) uint8_t hidden2[NNUE_L2];
+
+  // the side to move's half comes first
+  clipKernel(accumulator.values[side], input);
+  clipKernel(accumulator.values[!side], input + NNUE_HIDDEN);
+
+  hiddenLayer(input, 2 * NNUE_HIDDEN, l1Weights, l1Biases, NNUE_L1, hidden1);
+  hiddenLayer(hidden1, NNUE_L1, l2Weights, l2Biases, NNUE_L2, hidden2);
+
+  int32_t output = *outputBias + dotKernel(hidden2, outputWeights, NNUE_L2);
+  return output / NNUE_OUTPUT_SCALE;
+}
+
+void AccumulatorStack::refresh(const ChessBoard &board, int side,
+                               Accumulator &accumulator) const {
+  Piece king = side ? Piece::BlackKing : Piece::WhiteKing;
+  int kingSquare = __builtin_ctzll(board.getPieceBitboard(king));
+  // loadFen admits at most NNUE_MAX_PIECES; the bound is only a safeguard
+  int features[NNUE_MAX_PIECES];
+  int count = 0;
+  for (uint64_t pieces = board.getWhitePieces() | board.getBlackPieces();
+       pieces && count < NNUE_MAX_PIECES; pieces &= pieces - 1) {
+    int square = __builtin_ctzll(pieces);
+    features[count++] =
+        nnueFeature(side, kingSquare, uint8_t(board.getPiece(square)), square);
+  }
+  network->refresh(features, count, accumulator.values[side]);
+}
+
+void AccumulatorStack::reset(const ChessBoard &board) {
+  current = 0;
+  refresh(board, 0, accumulators[0]);
+  refresh(board, 1, accumulators[0]);
+}
+
+void AccumulatorStack::push(const ChessBoard &after, const BoardState &state) {
+  const Move &move = state.move;
+  bool mover = !after.sideToMove;
+  Piece placedPiece = after.getPiece(move.to());
+  Piece movingPiece = placedPiece;
+  if (move.isPromotion()) {
+    movingPiece = mover ? Piece::BlackPawn : Piece::WhitePawn;
+  }
+  uint8_t captureSquare = move.to();
+  if (move.isEnPassant()) {
+    captureSquare = mover ? move.to() + 8 : move.to() - 8;
+  }
+
+  // pieces that left a square and pieces that arrived on one
+  Piece removedPieces[NNUE_MAX_CHANGES] = {movingPiece, state.capturedPiece};
+  uint8_t removedSquares[NNUE_MAX_CHANGES] = {move.from(), captureSquare};
+  int removedCount = state.capturedPiece != Piece::Empty ? 2 : 1;
+  Piece addedPieces[NNUE_MAX_CHANGES] = {placedPiece};
+  uint8_t addedSquares[NNUE_MAX_CHANGES] = {move.to()};
+  int addedCount = 1;
+
+  if (move.isCastle()) {
+    bool kingSide = move.flags() == MoveFlag::KingCastle;
+    uint8_t rookTo = kingSide ? move.to() - 1 : move.to() + 1;
+    removedPieces[1] = addedPieces[1] = after.getPiece(rookTo);
+    removedSquares[1] = kingSide ? move.to() + 1 : move.to() - 2;
+    addedSquares[1] = rookTo;
+    removedCount = addedCount = 2;
+  }
+
+  if (++current == accumulators.size()) {
+    accumulators.emplace_back();
+  }
+  Accumulator &next = accumulators[current];
+  const Accumulator &previous = accumulators[current - 1];
+
+  for (int side = 0; side < 2; side++) {
+    Piece king = side ? Piece::BlackKing : Piece::WhiteKing;
+    if (movingPiece == king && nnueBucket(side, move.from()) !=
+                                   nnueBucket(side, move.to())) {
+      refresh(after, side, next);
+      continue;
+    }
+
+    int kingSquare = __builtin_ctzll(after.getPieceBitboard(king));
+    int added[NNUE_MAX_CHANGES];
+    int removed[NNUE_MAX_CHANGES];
+    for (int i = 0; i < addedCount; i++) {
+      added[i] = nnueFeature(side, kingSquare, uint8_t(addedPieces[i]),
+                             addedSquares[i]);
+    }
+    for (int i = 0; i < removedCount; i++) {
+      removed[i] = nnueFeature(side, kingSquare, uint8_t(removedPieces[i]),
+                               removedSquares[i]);
+    }
+    network->update(previous.values[side], added, addedCount, removed,
+                    removedCount, next.values[side]);
+  }
+}
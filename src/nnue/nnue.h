@@ -0,0 +1,265 @@
+#ifndef NNUE_H
+#define NNUE_H
+
+#include "../chess_board/chess_board.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Efficiently updatable neural network evaluation.
+ *
+ * Inputs are king-relative piece-square features seen from each side: the
+ * own king's square selects one of 16 buckets (2x2 blocks of the board,
+ * mirrored vertically for black), and every piece, kings included, sets
+ * one feature for its bucket, kind, color relative to the viewer, and
+ * square. A move that keeps the king in its bucket changes at most four
+ * features per side, so the first layer output (the accumulator) is
+ * updated with a few vector adds and subtracts instead of recomputed.
+ *
+ * Layers, all integer:
+ *   features -> 2 x 256 int16 accumulator (one half per side)
+ *   clipped to [0, 127], side to move first -> 512 x uint8
+ *   512 -> 32 (int8 weights, int32 sums >> 6, clipped) -> 32 -> 1
+ *
+ * Kernels come in AVX2, SSE4.1 and scalar versions with identical
+ * results; the fastest one the CPU supports is picked at startup.
+ */
+
+const int NNUE_KING_BUCKETS = 16;
+const int NNUE_FEATURES = NNUE_KING_BUCKETS * 12 * 64;
+const int NNUE_HIDDEN = 256; /// Accumulator size per side
+const int NNUE_L1 = 32;
+const int NNUE_L2 = 32;
+const int NNUE_WEIGHT_SHIFT = 6;  /// Hidden layer sums are scaled by 64
+const int NNUE_OUTPUT_SCALE = 16; /// Output units per centipawn
+
+/// Most features a move adds or removes on one side (castling, captures)
+const int NNUE_MAX_CHANGES = 2;
+
+/// Most features active at once: one per piece, 16 a side
+const int NNUE_MAX_PIECES = 32;
+
+/**
+ * Weight file header. The file is this header followed by, in order and
+ * little endian: feature weights int16[FEATURES][HIDDEN], feature biases
+ * int16[HIDDEN], L1 weights int8[L1][2 * HIDDEN], L1 biases int32[L1],
+ * L2 weights int8[L2][L1], L2 biases int32[L2], output weights int8[L2]
+ * and the output bias int32.
+ */
+struct NnueHeader {
+  char magic[4];        /// "NNUE"
+  uint32_t version;     /// NNUE_VERSION
+  uint32_t features;    /// NNUE_FEATURES
+  uint32_t hidden;      /// NNUE_HIDDEN
+  uint8_t reserved[48]; /// Pads the header to one cache line
+};
+
+const uint32_t NNUE_VERSION = 1;
+
+/**
+ * Size in bytes of a weight file for this architecture.
+ */
+constexpr size_t nnueFileSize() {
+  return sizeof(NnueHeader) + NNUE_FEATURES * NNUE_HIDDEN * 2 +
+         NNUE_HIDDEN * 2 + NNUE_L1 * 2 * NNUE_HIDDEN + NNUE_L1 * 4 +
+         NNUE_L2 * NNUE_L1 + NNUE_L2 * 4 + NNUE_L2 + 4;
+}
+
+/**
+ * First layer output for both sides of one position.
+ */
+struct alignas(64) Accumulator {
+  int16_t values[2][NNUE_HIDDEN]; /// White's view, then black's
+};
+
+/**
+ * Vector instruction set used by the kernels.
+ */
+enum class SimdBackend : uint8_t { Scalar, Sse41, Avx2 };
+
+/**
+ * Gets the best backend this CPU supports.
+ */
+SimdBackend cpuSimdBackend();
+
+/**
+ * Selects the kernels to use, e.g. to compare backends. Falls back to
+ * the best supported one below the request.
+ *
+ * @param backend Requested backend
+ */
+void setSimdBackend(SimdBackend backend);
+
+SimdBackend getSimdBackend();
+
+const char *simdBackendName(SimdBackend backend);
+
+/**
+ * Network weights, read straight from a memory-mapped weight file.
+ */
+class Network {
+public:
+  Network() = default;
+  ~Network();
+
+  Network(const Network &) = delete;
+  Network &operator=(const Network &) = delete;
+
+  /**
+   * Maps a weight file, replacing any loaded network.
+   *
+   * @param path Weight file to load
+   * @return true if the file exists and matches this architecture
+   */
+  bool load(const std::string &path);
+
+  bool isLoaded() const { return data != nullptr; }
+
+  /**
+   * Computes one side's accumulator from scratch.
+   *
+   * @param features Active features of that side
+   * @param count Number of features, at most NNUE_MAX_PIECES
+   * @param out Accumulator half to fill
+   */
+  void refresh(const int *features, int count, int16_t *out) const;
+
+  /**
+   * Derives one side's accumulator from the previous position's.
+   *
+   * @param previous Accumulator half before the move
+   * @param added Features the move turns on
+   * @param addedCount Number of added features
+   * @param removed Features the move turns off
+   * @param removedCount Number of removed features
+   * @param out Accumulator half to fill; may alias previous
+   */
+  void update(const int16_t *previous, const int *added, int addedCount,
+              const int *removed, int removedCount, int16_t *out) const;
+
+  /**
+   * Runs the layers after the accumulator.
+   *
+   * @param accumulator Accumulator of the position
+   * @param side Side to move (0 = white, 1 = black)
+   * @return Score in centipawns from the side to move's point of view
+   */
+  int evaluate(const Accumulator &accumulator, int side) const;
+
+private:
+  void release();
+
+  const uint8_t *data = nullptr; /// Start of the mapping (or buffer)
+  size_t size = 0;
+  bool mapped = false; /// true if data must be unmapped, false if freed
+
+  const int16_t *featureWeights = nullptr;
+  const int16_t *featureBiases = nullptr;
+  const int8_t *l1Weights = nullptr;
+  const int32_t *l1Biases = nullptr;
+  const int8_t *l2Weights = nullptr;
+  const int32_t *l2Biases = nullptr;
+  const int8_t *outputWeights = nullptr;
+  const int32_t *outputBias = nullptr;
+};
+
+/**
+ * Gets the king bucket of one side.
+ *
+ * @param side Viewing side (0 = white, 1 = black)
+ * @param kingSquare Square of that side's king
+ * @return Bucket index below NNUE_KING_BUCKETS
+ */
+inline int nnueBucket(int side, int kingSquare) {
+  // black sees the board upside down, so both sides view it the same way
+  int king = kingSquare ^ (side ? 56 : 0);
+  return (king >> 4) * 4 + (king & 7) / 2;
+}
+
+/**
+ * Gets the input feature of a piece as seen by one side.
+ *
+ * @param side Viewing side (0 = white, 1 = black)
+ * @param kingSquare Square of the viewing side's king
+ * @param piece Piece value (see Piece), not empty
+ * @param square Square of the piece
+ * @return Feature index below NNUE_FEATURES
+ */
+inline int nnueFeature(int side, int kingSquare, uint8_t piece, int square) {
+  int kind = (piece & 7) - 1 + ((piece >> 3) != side ? 6 : 0);
+  return (nnueBucket(side, kingSquare) * 12 + kind) * 64 +
+         (square ^ (side ? 56 : 0));
+}
+
+/**
+ * Accumulators of the positions along a line of play, kept next to the
+ * board rather than in it so the board stays a small copyable value.
+ *
+ * Push after each ChessBoard::makeMove and pop with each unmakeMove. The
+ * stack only grows, so after the first few searches no move allocates.
+ */
+class AccumulatorStack {
+public:
+  /**
+   * @param network Evaluation network, or nullptr for none
+   */
+  explicit AccumulatorStack(const Network *network = nullptr)
+      : network(network), accumulators(1) {}
+
+  /**
+   * Attaches a network. Call reset before the next evaluation.
+   *
+   * @param newNetwork Loaded network, or nullptr to detach
+   */
+  void setNetwork(const Network *newNetwork) { network = newNetwork; }
+
+  const Network *getNetwork() const { return network; }
+
+  /**
+   * Restarts the stack from a position, computing its accumulator.
+   *
+   * @param board Root position
+   */
+  void reset(const ChessBoard &board);
+
+  /**
+   * Derives the accumulator of the position after a move from the one
+   * before it, refreshing a side whose king changed bucket.
+   *
+   * @param after Board after the move
+   * @param state State filled by the move
+   */
+  void push(const ChessBoard &after, const BoardState &state);
+
+  /**
+   * Returns to the previous position's accumulator.
+   */
+  void pop() { current--; }
+
+  const Accumulator &top() const { return accumulators[current]; }
+
+  /**
+   * Evaluates the top position with the network.
+   *
+   * @param board Board matching the top of the stack
+   * @return Score in centipawns from the side to move's point of view
+   */
+  int evaluate(const ChessBoard &board) const {
+    return network->evaluate(accumulators[current], board.sideToMove);
+  }
+
+private:
+  /**
+   * Computes one side's half of an accumulator from the pieces on a board.
+   */
+  void refresh(const ChessBoard &board, int side,
+               Accumulator &accumulator) const;
+
+  const Network *network;
+  std::vector<Accumulator> accumulators;
+  size_t current = 0; /// Index of the top position's accumulator
+};
+
+#endif
@@ -0,0 +1,182 @@
+#include "pawn_table.h"
+#include "../attacks/attacks.h"
+#include "../psqt/psqt.h"
+#include <array>
+
+static constexpr int32_t DOUBLED = makeScore(-10, -25);
+static constexpr int32_t ISOLATED = makeScore(-5, -15);
+static constexpr int32_t BACKWARD = makeScore(-9, -20);
+
+/// Passed pawn bonus by rank, counted from the pawn's own side
+static constexpr int32_t PASSED[8] = {
+    makeScore(0, 0),   makeScore(2, 5),   makeScore(5, 10),
+    makeScore(10, 20), makeScore(25, 45), makeScore(45, 85),
+    makeScore(70, 130), makeScore(0, 0),
+};
+
+/// Shield pawns one and two ranks in front of the king
+static constexpr int SHIELD_NEAR = 15;
+static constexpr int SHIELD_FAR = 8;
+
+/**
+ * Files next to each file.
+ */
+constexpr std::array<uint64_t, 8> generateAdjacentFiles() {
+  std::array<uint64_t, 8> table{};
+  for (int file = 0; file < 8; file++) {
+    if (file > 0)
+      table[file] |= FILE_A << (file - 1);
+    if (file < 7)
+      table[file] |= FILE_A << (file + 1);
+  }
+  return table;
+}
+
+/**
+ * Squares on the same and adjacent files strictly ahead of a pawn, which
+ * must hold no enemy pawns for it to be passed.
+ */
+constexpr std::array<std::array<uint64_t, 64>, 2> generatePassedMasks() {
+  std::array<std::array<uint64_t, 64>, 2> table{};
+  for (int sq = 0; sq < 64; sq++) {
+    int rank = sq / 8;
+    int file = sq % 8;
+    for (int r = 0; r < 8; r++) {
+      for (int f = file - 1; f <= file + 1; f++) {
+        if (f < 0 || f > 7)
+          continue;
+        if (r > rank)
+          table[0][sq] |= 1ULL << (r * 8 + f);
+        if (r < rank)
+          table[1][sq] |= 1ULL << (r * 8 + f);
+      }
+    }
+  }
+  return table;
+}
+
+/**
+ * Squares on the king's and adjacent files one rank (index 0) and two ranks
+ * (index 1) in front of a king, where its shield pawns stand.
+ */
+constexpr std::array<std::array<std::array<uint64_t, 2>, 64>, 2>
+generateShieldMasks() {
+  std::array<std::array<std::array<uint64_t, 2>, 64>, 2> table{};
+  for (int sq = 0; sq < 64; sq++) {
+    int rank = sq / 8;
+    int file = sq % 8;
+    for (int f = file - 1; f <= file + 1; f++) {
+      if (f < 0 || f > 7)
+        continue;
+      for (int distance = 1; distance <= 2; distance++) {
+        if (rank + distance < 8)
+          table[0][sq][distance - 1] |= 1ULL << ((rank + distance) * 8 + f);
+        if (rank - distance >= 0)
+          table[1][sq][distance - 1] |= 1ULL << ((rank - distance) * 8 + f);
+      }
+    }
+  }
+  return table;
+}
+
+static constexpr std::array<uint64_t, 8> ADJACENT_FILES =
+    generateAdjacentFiles();
+static constexpr std::array<std::array<uint64_t, 64>, 2> PASSED_MASKS =
+    generatePassedMasks();
+static constexpr std::array<std::array<std::array<uint64_t, 2>, 64>, 2>
+    SHIELD_MASKS = generateShieldMasks();
+
+/**
+ * Scores the pawns of one side and collects its passed pawns.
+ *
+ * @param side Color to score (0 = white, 1 = black)
+ * @param own Pawns of that side
+ * @param enemy Pawns of the other side
+ * @param passed Set to the passed pawns of that side
+ * @return Packed score from that side's point of view
+ */
+static int32_t evaluatePawns(int side, uint64_t own, uint64_t enemy,
+                             uint64_t &passed) {
+  int32_t score = 0;
+  passed = 0;
+
+  for (uint64_t pawns = own; pawns; pawns &= pawns - 1) {
+    int sq = __builtin_ctzll(pawns);
+    int file = sq % 8;
+    int relativeRank = side ? 7 - sq / 8 : sq / 8;
+    uint64_t fileMask = FILE_A << file;
+    uint64_t ahead = PASSED_MASKS[side][sq] & fileMask;
+
+    if (own & ahead) {
+      score += DOUBLED;
+    }
+
+    uint64_t neighbours = own & ADJACENT_FILES[file];
+    if (!neighbours) {
+      score += ISOLATED;
+    } else if (!(neighbours & ~PASSED_MASKS[side][sq])) {
+      // every neighbour has advanced past it; backward if it cannot step
+      // up safely to join them
+      int stop = side ? sq - 8 : sq + 8;
+      if (PAWN_ATTACKS[side][stop] & enemy) {
+        score += BACKWARD;
+      }
+    }
+
+    if (!(enemy & PASSED_MASKS[side][sq]) && !(own & ahead)) {
+      passed |= 1ULL << sq;
+      score += PASSED[relativeRank];
+    }
+  }
+
+  return score;
+}
+
+int32_t PawnEntry::kingShelter(const ChessBoard &board, int side) {
+  Piece king = side ? Piece::BlackKing : Piece::WhiteKing;
+  int kingSq = __builtin_ctzll(board.getPieceBitboard(king));
+  if (kingSquare[side] == kingSq) {
+    return shelter[side];
+  }
+
+  uint64_t pawns =
+      board.getPieceBitboard(side ? Piece::BlackPawn : Piece::WhitePawn);
+  const std::array<uint64_t, 2> &shield = SHIELD_MASKS[side][kingSq];
+  int bonus = SHIELD_NEAR * __builtin_popcountll(pawns & shield[0]) +
+              SHIELD_FAR * __builtin_popcountll(pawns & shield[1]);
+
+  kingSquare[side] = kingSq;
+  shelter[side] = makeScore(side ? -bonus : bonus, 0);
+  return shelter[side];
+}
+
+PawnTable::PawnTable() : entries(ENTRIES) { clear(); }
+
+void PawnTable::clear() {
+  for (PawnEntry &entry : entries) {
+    // key 0 is the empty structure, whose score and passers are zero
+    entry = PawnEntry{};
+    entry.kingSquare[0] = entry.kingSquare[1] = 0xFF;
+  }
+  probes = 0;
+  hits = 0;
+}
+
+PawnEntry &PawnTable::probe(const ChessBoard &board) {
+  uint64_t key = board.getPawnKey();
+  PawnEntry &entry = entries[key & (ENTRIES - 1)];
+  probes++;
+  if (entry.key == key) {
+    hits++;
+    return entry;
+  }
+
+  uint64_t white = board.getPieceBitboard(Piece::WhitePawn);
+  uint64_t black = board.getPieceBitboard(Piece::BlackPawn);
+
+  entry.key = key;
+  entry.score = evaluatePawns(0, white, black, entry.passedPawns[0]) -
+                evaluatePawns(1, black, white, entry.passedPawns[1]);
+  entry.kingSquare[0] = entry.kingSquare[1] = 0xFF;
+  return entry;
+}
@@ -0,0 +1,69 @@
+#ifndef PAWN_TABLE_H
+#define PAWN_TABLE_H
+
+#include "../chess_board/chess_board.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Cached evaluation of one pawn structure. Scores are packed
+ * midgame/endgame values (see psqt.h) from white's point of view.
+ */
+struct PawnEntry {
+  uint64_t key;            /// Pawn key of the structure
+  uint64_t passedPawns[2]; /// Passed pawns of white and black
+  int32_t score;           /// Doubled, isolated, backward and passed pawns
+  int32_t shelter[2];      /// Pawn shield in front of each king
+  uint8_t kingSquare[2];   /// King squares the shelters belong to
+
+  /**
+   * Gets the pawn shield score of a side's king. It only depends on the
+   * pawns and the king square, so it is recomputed only when the king has
+   * moved since the last call.
+   *
+   * @param board Position with this entry's pawn structure
+   * @param side Color of the king (0 = white, 1 = black)
+   * @return Packed score from white's point of view
+   */
+  int32_t kingShelter(const ChessBoard &board, int side);
+};
+
+/**
+ * Cache of pawn structure evaluations, indexed by the board's pawn key.
+ *
+ * Pawns move far less often than other pieces, so nearly every probe hits
+ * and the structure terms are almost free. Each search thread owns one,
+ * so it needs no locking; at 4096 entries of 40 bytes (160 KB) it fits in
+ * a typical L2 cache next to the search's own tables.
+ */
+class PawnTable {
+public:
+  static const size_t ENTRIES = 4096; /// Power of two
+
+  PawnTable();
+
+  /**
+   * Finds the entry for the board's pawn structure, evaluating the
+   * structure and replacing the slot on a miss.
+   *
+   * @param board Position to look up
+   * @return Entry holding the structure's score and passed pawns
+   */
+  PawnEntry &probe(const ChessBoard &board);
+
+  /**
+   * Empties every entry and resets the hit counters.
+   */
+  void clear();
+
+  uint64_t getProbes() const { return probes; }
+  uint64_t getHits() const { return hits; }
+
+private:
+  std::vector<PawnEntry> entries;
+  uint64_t probes;
+  uint64_t hits;
+};
+
+#endif
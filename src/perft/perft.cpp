@@ -0,0 +1,248 @@
+#include "perft.h"
+#include <algorithm>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+const std::vector<PerftPosition> PERFT_POSITIONS = {
+    {"startpos",
+     "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+     {20, 400, 8902, 197281, 4865609, 119060324}},
+    {"kiwipete",
+     "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+     {48, 2039, 97862, 4085603, 193690690}},
+    {"position3",
+     "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+     {14, 191, 2812, 43238, 674624, 11030083}},
+    {"position4",
+     "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+     {6, 264, 9467, 422333, 15833292}},
+    {"position5",
+     "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+     {44, 1486, 62379, 2103487, 89941194}},
+    {"position6",
+     "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+     {46, 2079, 89890, 3894594, 164075551}},
+};
+
+uint64_t perft(ChessBoard &board, int depth) {
+  if (depth == 0) {
+    return 1;
+  }
+
+  // every generated move is legal, so the last ply is just counted
+  MoveList moves;
+  board.generateMoves(moves);
+  if (depth == 1) {
+    return moves.size();
+  }
+
+  uint64_t nodes = 0;
+  BoardState state;
+  for (Move move : moves) {
+    board.makeMove(move, state);
+    nodes += perft(board, depth - 1);
+    board.unmakeMove(state);
+  }
+
+  return nodes;
+}
+
+std::vector<PerftDivideEntry> perftDivide(ChessBoard &board, int depth) {
+  std::vector<PerftDivideEntry> entries;
+  if (depth < 1) {
+    return entries;
+  }
+
+  MoveList moves;
+  board.generateMoves(moves);
+
+  BoardState state;
+  for (Move move : moves) {
+    board.makeMove(move, state);
+    entries.push_back({move, perft(board, depth - 1)});
+    board.unmakeMove(state);
+  }
+
+  return entries;
+}
+
+PerftHash::PerftHash(size_t megabytes)
+    : slotCount(std::max<size_t>(1, megabytes * 1024 * 1024 / sizeof(Slot))) {
+  slots.reset(new Slot[slotCount]());
+}
+
+bool PerftHash::probe(uint64_t key, int depth, uint64_t &nodes) const {
+  const Slot &slot = slotFor(key);
+  uint64_t data = slot.data.load(std::memory_order_relaxed);
+  uint64_t check = slot.check.load(std::memory_order_relaxed);
+
+  if ((check ^ data) != key || (int)(data >> 56) != depth) {
+    return false;
+  }
+
+  nodes = data & 0x00FFFFFFFFFFFFFFULL;
+  return true;
+}
+
+void PerftHash::store(uint64_t key, int depth, uint64_t nodes) {
+  Slot &slot = slotFor(key);
+  uint64_t data = nodes | (uint64_t)depth << 56;
+  slot.check.store(key ^ data, std::memory_order_relaxed);
+  slot.data.store(data, std::memory_order_relaxed);
+}
+
+uint64_t perft(ChessBoard &board, int depth, PerftHash &hash) {
+  if (depth <= 1) {
+    return perft(board, depth);
+  }
+
+  uint64_t key = board.getZobristKey();
+  uint64_t nodes = 0;
+  if (hash.probe(key, depth, nodes)) {
+    return nodes;
+  }
+
+  MoveList moves;
+  board.generateMoves(moves);
+
+  BoardState state;
+  for (Move move : moves) {
+    board.makeMove(move, state);
+    nodes += perft(board, depth - 1, hash);
+    board.unmakeMove(state);
+  }
+
+  hash.store(key, depth, nodes);
+  return nodes;
+}
+
+namespace {
+
+/**
+ * A subtree to count: the moves leading to it from the root.
+ */
+struct PerftTask {
+  int rootIndex; /// Index of the root move in the divide output
+  Move path[2];
+  int pathLength;
+  uint64_t nodes;
+};
+
+/**
+ * Task queue of one worker. The owner takes from the back, thieves from
+ * the front, so they rarely compete for the same end.
+ */
+struct WorkQueue {
+  std::mutex mutex;
+  std::deque<PerftTask *> tasks;
+
+  PerftTask *pop() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (tasks.empty()) {
+      return nullptr;
+    }
+    PerftTask *task = tasks.back();
+    tasks.pop_back();
+    return task;
+  }
+
+  PerftTask *steal() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (tasks.empty()) {
+      return nullptr;
+    }
+    PerftTask *task = tasks.front();
+    tasks.pop_front();
+    return task;
+  }
+};
+
+void runTask(ChessBoard &board, int depth, PerftTask &task, PerftHash *hash) {
+  BoardState states[2];
+  for (int i = 0; i < task.pathLength; i++) {
+    board.makeMove(task.path[i], states[i]);
+  }
+
+  int remaining = depth - task.pathLength;
+  task.nodes = hash ? perft(board, remaining, *hash) : perft(board, remaining);
+
+  for (int i = task.pathLength - 1; i >= 0; i--) {
+    board.unmakeMove(states[i]);
+  }
+}
+
+} // namespace
+
+std::vector<PerftDivideEntry> perftDivideParallel(const ChessBoard &board,
+                                                  int depth, int threads,
+                                                  PerftHash *hash) {
+  std::vector<PerftDivideEntry> entries;
+  if (depth < 1) {
+    return entries;
+  }
+  threads = std::max(threads, 1);
+
+  // Split below the root as well when there is enough depth, so a few
+  // large root subtrees cannot leave the other threads idle
+  ChessBoard root = board;
+  std::vector<PerftTask> tasks;
+  MoveList moves;
+  root.generateMoves(moves);
+
+  BoardState state;
+  for (Move move : moves) {
+    root.makeMove(move, state);
+    int rootIndex = entries.size();
+    entries.push_back({move, 0});
+
+    if (depth >= 4) {
+      MoveList replies;
+      root.generateMoves(replies);
+      for (Move reply : replies) {
+        tasks.push_back({rootIndex, {move, reply}, 2, 0});
+      }
+    } else {
+      tasks.push_back({rootIndex, {move, Move::none()}, 1, 0});
+    }
+
+    root.unmakeMove(state);
+  }
+
+  // Deal the tasks out round-robin; stealing evens out the rest
+  std::vector<WorkQueue> queues(threads);
+  for (size_t i = 0; i < tasks.size(); i++) {
+    queues[i % threads].tasks.push_back(&tasks[i]);
+  }
+
+  auto worker = [&](int id) {
+    ChessBoard local = board;
+
+    while (true) {
+      PerftTask *task = queues[id].pop();
+      for (int i = 1; !task && i < threads; i++) {
+        task = queues[(id + i) % threads].steal();
+      }
+      // Tasks are never added once the workers run, so empty means done
+      if (!task) {
+        return;
+      }
+      runTask(local, depth, *task, hash);
+    }
+  };
+
+  std::vector<std::thread> workers;
+  for (int i = 1; i < threads; i++) {
+    workers.emplace_back(worker, i);
+  }
+  worker(0);
+  for (std::thread &thread : workers) {
+    thread.join();
+  }
+
+  for (const PerftTask &task : tasks) {
+    entries[task.rootIndex].nodes += task.nodes;
+  }
+
+  return entries;
+}
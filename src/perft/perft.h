@@ -0,0 +1,121 @@
+#ifndef PERFT_H
+#define PERFT_H
+
+#include "../chess_board/chess_board.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/**
+ * A reference position with known move path enumeration results.
+ */
+struct PerftPosition {
+  const char *name;
+  const char *fen;
+  std::vector<uint64_t> expected; /// Node counts, index 0 = depth 1
+};
+
+/**
+ * Node count reached through a single root move.
+ */
+struct PerftDivideEntry {
+  Move move;
+  uint64_t nodes;
+};
+
+/**
+ * Lock-free cache of subtree node counts keyed by Zobrist key and depth,
+ * shared by all perft threads.
+ *
+ * Each slot stores key ^ data next to data, so a slot torn by concurrent
+ * writers fails the key check instead of returning a wrong count.
+ */
+class PerftHash {
+public:
+  /**
+   * @param megabytes Table size; rounded down to whole slots
+   */
+  explicit PerftHash(size_t megabytes);
+
+  /**
+   * Looks up the node count of a subtree.
+   *
+   * @param key Zobrist key of the subtree root
+   * @param depth Remaining depth
+   * @param nodes Receives the node count on a hit
+   * @return True on a hit
+   */
+  bool probe(uint64_t key, int depth, uint64_t &nodes) const;
+
+  /**
+   * Stores the node count of a subtree, replacing whatever was in the slot.
+   */
+  void store(uint64_t key, int depth, uint64_t nodes);
+
+private:
+  struct Slot {
+    std::atomic<uint64_t> check; /// key ^ data
+    std::atomic<uint64_t> data;  /// nodes in bits 0-55, depth in 56-63
+  };
+
+  std::unique_ptr<Slot[]> slots;
+  size_t slotCount;
+
+  Slot &slotFor(uint64_t key) const {
+    return slots[(unsigned __int128)key * slotCount >> 64];
+  }
+};
+
+/**
+ * Standard perft positions (start position, Kiwipete and friends).
+ */
+extern const std::vector<PerftPosition> PERFT_POSITIONS;
+
+/**
+ * Counts the leaf nodes of the legal move tree to the given depth.
+ *
+ * @param board Position to start from
+ * @param depth Number of plies to walk
+ * @return Number of leaf nodes
+ */
+uint64_t perft(ChessBoard &board, int depth);
+
+/**
+ * Runs perft below each legal root move separately.
+ *
+ * @param board Position to start from
+ * @param depth Number of plies to walk, including the root move
+ * @return One entry per legal root move
+ */
+std::vector<PerftDivideEntry> perftDivide(ChessBoard &board, int depth);
+
+/**
+ * Counts leaf nodes like perft(), reusing subtree counts from a hash.
+ *
+ * @param board Position to start from
+ * @param depth Number of plies to walk
+ * @param hash Cache shared with other threads
+ * @return Number of leaf nodes
+ */
+uint64_t perft(ChessBoard &board, int depth, PerftHash &hash);
+
+/**
+ * Runs perftDivide() on several threads.
+ *
+ * The first one or two plies are expanded into tasks that are dealt out to
+ * per-thread queues; a thread that runs out of work steals from the others.
+ * Every thread works on its own copy of the board.
+ *
+ * @param board Position to start from; left unchanged
+ * @param depth Number of plies to walk, including the root move
+ * @param threads Number of worker threads
+ * @param hash Optional cache shared by all threads, or nullptr
+ * @return One entry per legal root move, in generation order
+ */
+std::vector<PerftDivideEntry> perftDivideParallel(const ChessBoard &board,
+                                                  int depth, int threads,
+                                                  PerftHash *hash = nullptr);
+
+#endif
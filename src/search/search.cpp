@@ -0,0 +1,415 @@
+#include "search.h"
+#include "../evaluation/evaluation.h"
+#include "../move_picker/move_picker.h"
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+// Mate scores are stored relative to the node instead of the root, so the
+// same entry is correct wherever the position is reached
+static int scoreToTT(int score, int ply) {
+  if (score >= MATE_BOUND)
+    return score + ply;
+  if (score <= -MATE_BOUND)
+    return score - ply;
+  return score;
+}
+
+static int scoreFromTT(int score, int ply) {
+  if (score >= MATE_BOUND)
+    return score - ply;
+  if (score <= -MATE_BOUND)
+    return score + ply;
+  return score;
+}
+
+// Depth staggering for helper threads: helper i searches depth d only if
+// (d + SKIP_PHASE[i]) / SKIP_SIZE[i] is even
+static const int SKIP_SIZE[20] = {1, 1, 2, 2, 2, 2, 3, 3, 3, 3,
+                                  3, 3, 4, 4, 4, 4, 4, 4, 4, 4};
+static const int SKIP_PHASE[20] = {0, 1, 0, 1, 2, 3, 0, 1, 2, 3,
+                                   4, 5, 0, 1, 2, 3, 4, 5, 6, 7};
+
+Search::Search(TranspositionTable &tt, int threadId,
+               std::atomic<bool> *sharedStop)
+    : tt(tt), game(&ownGame), threadId(threadId), ownStop(false),
+      stopped(sharedStop ? *sharedStop : ownStop), softTimeLimit(0),
+      hardTimeLimit(0), nodes(0), selDepth(0) {}
+
+int64_t Search::elapsed() const {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now() - startTime)
+      .count();
+}
+
+void Search::setupTimeLimits(bool blackToMove) {
+  softTimeLimit = 0;
+  hardTimeLimit = 0;
+
+  if (limits.infinite) {
+    return;
+  }
+
+  if (limits.moveTime > 0) {
+    softTimeLimit = hardTimeLimit = limits.moveTime;
+    return;
+  }
+
+  int64_t remaining = limits.time[blackToMove];
+  if (remaining <= 0) {
+    return;
+  }
+
+  // Spread the clock over the moves left (assume 30 in sudden death),
+  // keeping a margin for move overhead
+  int movesToGo = limits.movesToGo > 0 ? limits.movesToGo : 30;
+  int64_t budget =
+      remaining / movesToGo + limits.increment[blackToMove] * 3 / 4;
+  int64_t maximum = std::max<int64_t>(1, remaining - 50);
+
+  softTimeLimit = std::min(budget, maximum);
+  hardTimeLimit = std::min(budget * 3, maximum);
+}
+
+bool Search::visitNode() {
+  // Only this thread writes the counter, so a plain load/store is enough
+  uint64_t count = nodes.load(std::memory_order_relaxed) + 1;
+  nodes.store(count, std::memory_order_relaxed);
+
+  if ((count & 2047) == 0 && threadId == 0) {
+    checkLimits();
+  }
+  return stopped.load(std::memory_order_relaxed);
+}
+
+bool Search::skipDepth(int depth) const {
+  if (threadId == 0) {
+    return false;
+  }
+
+  int i = (threadId - 1) % 20;
+  return ((depth + SKIP_PHASE[i]) / SKIP_SIZE[i]) % 2 != 0;
+}
+
+void Search::checkLimits() {
+  if (limits.nodes &&
+      (countNodes ? countNodes() : getNodes()) >= limits.nodes) {
+    stopped = true;
+  }
+  if (hardTimeLimit && elapsed() >= hardTimeLimit) {
+    stopped = true;
+  }
+}
+
+void Search::makeMove(ChessBoard &board, Move move) {
+  game->makeMove(board, move);
+  if (nnue.getNetwork()) {
+    nnue.push(board, game->back());
+  }
+}
+
+void Search::unmakeMove(ChessBoard &board) {
+  game->unmakeMove(board);
+  if (nnue.getNetwork()) {
+    nnue.pop();
+  }
+}
+
+Move Search::think(ChessBoard &board, const SearchLimits &searchLimits) {
+  ownGame.clear();
+  return think(board, ownGame, searchLimits);
+}
+
+Move Search::think(ChessBoard &board, BoardHistory &gameHistory,
+                   const SearchLimits &searchLimits) {
+  game = &gameHistory;
+  if (nnue.getNetwork()) {
+    nnue.reset(board);
+  }
+  limits = searchLimits;
+  startTime = std::chrono::steady_clock::now();
+  setupTimeLimits(board.sideToMove);
+
+  // When run by a pool, the pool resets the shared stop flag and ages the
+  // table before any thread starts, so neither races with other threads
+  if (&stopped == &ownStop) {
+    stopped = false;
+    tt.newSearch();
+  }
+  nodes = 0;
+  std::memset(killers, 0, sizeof(killers));
+  std::memset(history, 0, sizeof(history));
+  std::memset(counterMoves, 0, sizeof(counterMoves));
+
+  // Fall back to the first legal move if not even depth 1 completes
+  MoveList rootMoves;
+  board.generateMoves(rootMoves);
+  if (rootMoves.empty()) {
+    waitForStop();
+    return Move::none();
+  }
+  Move bestMove = rootMoves[0];
+
+  int score = 0;
+  int maxDepth = std::min(limits.depth, MAX_PLY - 1);
+
+  for (int depth = 1; depth <= maxDepth; depth++) {
+    if (skipDepth(depth) && depth < maxDepth) {
+      continue;
+    }
+    selDepth = 0;
+
+    // Aspiration window around the last score, widened on failure
+    int delta = 25;
+    int alpha = -INFINITE_SCORE;
+    int beta = INFINITE_SCORE;
+    if (depth >= 5) {
+      alpha = std::max(score - delta, -INFINITE_SCORE);
+      beta = std::min(score + delta, INFINITE_SCORE);
+    }
+
+    int result;
+    while (true) {
+      result = negamax(board, alpha, beta, depth, 0);
+      if (stopped) {
+        break;
+      }
+
+      if (result <= alpha) {
+        beta = (alpha + beta) / 2;
+        alpha = std::max(result - delta, -INFINITE_SCORE);
+      } else if (result >= beta) {
+        beta = std::min(result + delta, INFINITE_SCORE);
+      } else {
+        break;
+      }
+      delta *= 2;
+    }
+
+    if (stopped) {
+      break;
+    }
+
+    score = result;
+    bestMove = pvTable[0][0];
+
+    if (onIteration) {
+      int64_t time = elapsed();
+      uint64_t visited = getNodes();
+      SearchInfo info{depth,
+                      selDepth,
+                      score,
+                      visited,
+                      time,
+                      time > 0 ? visited * 1000 / time : visited,
+                      std::vector<Move>(pvTable[0], pvTable[0] + pvLength[0])};
+      onIteration(info);
+    }
+
+    // A forced mate will not get any better
+    if (!limits.infinite && std::abs(score) >= MATE_BOUND) {
+      break;
+    }
+    if (softTimeLimit && elapsed() >= softTimeLimit) {
+      break;
+    }
+  }
+
+  waitForStop();
+  return bestMove;
+}
+
+void Search::waitForStop() {
+  if (!limits.infinite || threadId != 0) {
+    return;
+  }
+
+  // Polled rather than signalled: stop() is a plain store, and a
+  // millisecond of latency is nothing next to a GUI round trip
+  while (!stopped.load(std::memory_order_relaxed)) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+}
+
+int Search::negamax(ChessBoard &board, int alpha, int beta, int depth,
+                    int ply) {
+  pvLength[ply] = ply;
+
+  if (depth <= 0) {
+    return quiescence(board, alpha, beta, ply);
+  }
+
+  if (visitNode()) {
+    return 0;
+  }
+
+  bool root = ply == 0;
+  if (!root && game->isDraw(board)) {
+    return 0;
+  }
+  if (ply >= MAX_PLY - 1) {
+    return evaluate(board, pawnTable, &nnue);
+  }
+
+  uint64_t key = board.getZobristKey();
+  Move ttMove = Move::none();
+  TTEntry entry;
+  if (tt.probe(key, entry)) {
+    ttMove = entry.move;
+    int ttScore = scoreFromTT(entry.score, ply);
+    if (!root && entry.depth >= depth &&
+        (entry.bound == Bound::Exact ||
+         (entry.bound == Bound::Lower && ttScore >= beta) ||
+         (entry.bound == Bound::Upper && ttScore <= alpha))) {
+      return ttScore;
+    }
+  }
+
+  bool inCheck = board.inCheck();
+  if (inCheck) {
+    depth++; // check extension
+  }
+
+  MovePicker picker(board, ttMove, killers[ply], counterMoveFor(board),
+                    history[board.sideToMove]);
+
+  int originalAlpha = alpha;
+  int bestScore = -INFINITE_SCORE;
+  Move bestMove = Move::none();
+  int movesSearched = 0;
+
+  Move move;
+  while ((move = picker.next()) != Move::none()) {
+    movesSearched++;
+    makeMove(board, move);
+    int score = -negamax(board, -beta, -alpha, depth - 1, ply + 1);
+    unmakeMove(board);
+
+    if (stopped) {
+      return 0;
+    }
+
+    if (score > bestScore) {
+      bestScore = score;
+      bestMove = move;
+
+      if (score > alpha) {
+        alpha = score;
+
+        pvTable[ply][ply] = move;
+        for (int next = ply + 1; next < pvLength[ply + 1]; next++) {
+          pvTable[ply][next] = pvTable[ply + 1][next];
+        }
+        pvLength[ply] = pvLength[ply + 1];
+
+        if (alpha >= beta) {
+          if (!move.isCapture() && !move.isPromotion()) {
+            updateQuietStats(board, move, depth, ply);
+          }
+          break;
+        }
+      }
+    }
+  }
+
+  if (movesSearched == 0) {
+    return inCheck ? -MATE_SCORE + ply : 0;
+  }
+
+  Bound bound = bestScore >= beta            ? Bound::Lower
+                : bestScore > originalAlpha ? Bound::Exact
+                                            : Bound::Upper;
+  tt.store(key, bestMove, scoreToTT(bestScore, ply), 0, depth, bound);
+
+  return bestScore;
+}
+
+int Search::quiescence(ChessBoard &board, int alpha, int beta, int ply) {
+  pvLength[ply] = ply;
+
+  if (visitNode()) {
+    return 0;
+  }
+
+  selDepth = std::max(selDepth, ply);
+  if (ply >= MAX_PLY - 1) {
+    return evaluate(board, pawnTable, &nnue);
+  }
+
+  // In check every evasion is searched and standing pat is not allowed
+  bool inCheck = board.inCheck();
+  int bestScore = -INFINITE_SCORE;
+  if (!inCheck) {
+    bestScore = evaluate(board, pawnTable, &nnue);
+    if (bestScore >= beta) {
+      return bestScore;
+    }
+    alpha = std::max(alpha, bestScore);
+  }
+
+  MovePicker picker(board, Move::none(), history[board.sideToMove]);
+  int movesSearched = 0;
+
+  Move move;
+  while ((move = picker.next()) != Move::none()) {
+    movesSearched++;
+    makeMove(board, move);
+    int score = -quiescence(board, -beta, -alpha, ply + 1);
+    unmakeMove(board);
+
+    if (stopped) {
+      return 0;
+    }
+
+    if (score > bestScore) {
+      bestScore = score;
+      if (score > alpha) {
+        alpha = score;
+        if (alpha >= beta) {
+          break;
+        }
+      }
+    }
+  }
+
+  if (inCheck && movesSearched == 0) {
+    return -MATE_SCORE + ply;
+  }
+
+  return bestScore;
+}
+
+Move Search::counterMoveFor(const ChessBoard &board) const {
+  Move last = game->getLastMove();
+  if (last == Move::none()) {
+    return Move::none();
+  }
+  return counterMoves[uint8_t(board.getPiece(last.to()))][last.to()];
+}
+
+void Search::updateQuietStats(const ChessBoard &board, Move move, int depth,
+                              int ply) {
+  if (killers[ply][0] != move) {
+    killers[ply][1] = killers[ply][0];
+    killers[ply][0] = move;
+  }
+
+  Move last = game->getLastMove();
+  if (last != Move::none()) {
+    counterMoves[uint8_t(board.getPiece(last.to()))][last.to()] = move;
+  }
+
+  int &entry = history[board.sideToMove][move.from()][move.to()];
+  entry += depth * depth;
+
+  // Halve the whole table now and then so old results fade out
+  if (entry > 50000) {
+    for (auto &side : history) {
+      for (auto &from : side) {
+        for (int &value : from) {
+          value /= 2;
+        }
+      }
+    }
+  }
+}
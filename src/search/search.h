@@ -0,0 +1,186 @@
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include "../chess_board/chess_board.h"
+#include "../nnue/nnue.h"
+#include "../pawn_table/pawn_table.h"
+#include "../transposition_table/transposition_table.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+const int MAX_PLY = 128;
+const int MATE_SCORE = 32000;
+const int MATE_BOUND = MATE_SCORE - MAX_PLY; /// Scores beyond this are mates
+const int INFINITE_SCORE = 32001;
+
+/**
+ * Constraints on a search. Zero means "no limit" for nodes and times.
+ */
+struct SearchLimits {
+  int depth = MAX_PLY - 1;
+  uint64_t nodes = 0;
+  int64_t moveTime = 0;            /// Fixed time for this move, in ms
+  int64_t time[2] = {0, 0};        /// Remaining clock (white, black), in ms
+  int64_t increment[2] = {0, 0};   /// Increment per move, in ms
+  int movesToGo = 0;               /// Moves until the next time control
+  bool infinite = false;           /// Search until stopped
+};
+
+/**
+ * Progress report sent after each completed iteration.
+ */
+struct SearchInfo {
+  int depth;
+  int selDepth;
+  int score;
+  uint64_t nodes;
+  int64_t time; /// Elapsed time in ms
+  uint64_t nps;
+  std::vector<Move> pv;
+};
+
+/**
+ * Negamax alpha-beta search with iterative deepening, aspiration windows
+ * and quiescence search over captures and promotions.
+ *
+ * Moves are picked in stages by MovePicker: hash move, MVV-LVA captures,
+ * killer and counter moves, then quiets by the history heuristic. Results
+ * are shared through the transposition table.
+ */
+class Search {
+public:
+  /**
+   * @param tt Transposition table, may be shared with other searches
+   * @param threadId 0 for the main search; helpers (1+) skip some depths
+   *                 and leave time management and reporting to the main one
+   * @param sharedStop Stop flag shared by all threads of a search, or
+   *                   nullptr for a standalone search
+   */
+  explicit Search(TranspositionTable &tt, int threadId = 0,
+                  std::atomic<bool> *sharedStop = nullptr);
+
+  /**
+   * Searches the position within the given limits.
+   *
+   * @param board Position to search; restored before returning
+   * @param gameHistory Moves that led to the position, for repetitions;
+   *                    restored before returning
+   * @param limits Depth, node and time limits
+   * @return Best move found, or Move::none() if there are no legal moves
+   */
+  Move think(ChessBoard &board, BoardHistory &gameHistory,
+             const SearchLimits &limits);
+
+  /**
+   * Searches a position without any moves leading to it.
+   */
+  Move think(ChessBoard &board, const SearchLimits &limits);
+
+  /**
+   * Evaluates with a network from now on.
+   *
+   * @param network Loaded network, or nullptr for the classical evaluation
+   */
+  void setNetwork(const Network *network) { nnue.setNetwork(network); }
+
+  /**
+   * Asks a running search to stop as soon as possible. Thread-safe.
+   */
+  void stop() { stopped = true; }
+
+  /**
+   * Gets the number of nodes visited by the last or current search.
+   * Thread-safe.
+   */
+  uint64_t getNodes() const { return nodes.load(std::memory_order_relaxed); }
+
+  /// Called after each completed iteration, e.g. to print UCI info lines
+  std::function<void(const SearchInfo &)> onIteration;
+
+  /// Counts the nodes of all threads of the search for the node limit;
+  /// unset, only this thread's nodes count
+  std::function<uint64_t()> countNodes;
+
+  /**
+   * Gets this thread's pawn structure cache, e.g. for its hit rate.
+   */
+  const PawnTable &getPawnTable() const { return pawnTable; }
+
+private:
+  TranspositionTable &tt;
+  PawnTable pawnTable; /// Private to this thread, unlike tt
+  AccumulatorStack nnue; /// Follows the searched line if a network is set
+  BoardHistory ownGame;  /// History for searches given none
+  BoardHistory *game;    /// History of the current search
+  int threadId;
+  std::atomic<bool> ownStop;
+  std::atomic<bool> &stopped; /// ownStop, or the flag shared by the pool
+
+  SearchLimits limits;
+  std::chrono::steady_clock::time_point startTime;
+  int64_t softTimeLimit; /// Don't start another iteration after this
+  int64_t hardTimeLimit; /// Abort the iteration after this
+
+  std::atomic<uint64_t> nodes; /// Written by this thread only
+  int selDepth;
+
+  Move killers[MAX_PLY][2];
+  int history[2][64][64];
+  Move counterMoves[15][64]; /// By piece and destination of previous move
+
+  Move pvTable[MAX_PLY][MAX_PLY];
+  int pvLength[MAX_PLY];
+
+  /**
+   * Makes a move on the board, the history and the accumulators.
+   */
+  void makeMove(ChessBoard &board, Move move);
+  void unmakeMove(ChessBoard &board);
+
+  int negamax(ChessBoard &board, int alpha, int beta, int depth, int ply);
+  int quiescence(ChessBoard &board, int alpha, int beta, int ply);
+
+  /**
+   * Gets the quiet move that last refuted the move leading to this node.
+   */
+  Move counterMoveFor(const ChessBoard &board) const;
+
+  /**
+   * Records a quiet move that caused a beta cutoff as killer, counter move
+   * and in the history table.
+   */
+  void updateQuietStats(const ChessBoard &board, Move move, int depth,
+                        int ply);
+
+  /**
+   * Counts a node and checks the limits every 2048 nodes.
+   * @return True if the search has to stop
+   */
+  bool visitNode();
+
+  /**
+   * Checks if a helper thread should skip an iteration, so that threads
+   * spread over different depths instead of all searching the same tree.
+   */
+  bool skipDepth(int depth) const;
+
+  void setupTimeLimits(bool blackToMove);
+  int64_t elapsed() const;
+
+  /**
+   * Sets the stop flag once the node or time budget is used up.
+   */
+  void checkLimits();
+
+  /**
+   * Blocks an infinite search on the main thread until it is stopped, so
+   * the best move is only reported after stop, as UCI requires, even when
+   * there is nothing left to search.
+   */
+  void waitForStop();
+};
+
+#endif
@@ -0,0 +1,101 @@
+#include "see.h"
+#include "../evaluation/evaluation.h"
+#include "../magics/magics.h"
+
+bool seeGreaterOrEqual(const ChessBoard &board, Move move, int threshold) {
+  if (move.isCastle()) {
+    return threshold <= 0;
+  }
+
+  uint8_t from = move.from();
+  uint8_t to = move.to();
+  bool white = board.sideToMove == 0;
+
+  uint64_t occupied = board.getWhitePieces() | board.getBlackPieces();
+  Piece captured = board.getPiece(to);
+  Piece moving = board.getPiece(from);
+
+  if (move.isEnPassant()) {
+    captured = Piece::WhitePawn;
+    occupied ^= 1ULL << (white ? to - 8 : to + 8);
+  }
+  if (move.isPromotion()) {
+    // the promoted piece is what stands on the square afterwards
+    moving = Piece(uint8_t(Piece::WhiteKnight) + (move.flags() & 3));
+    threshold -= PIECE_VALUES[uint8_t(moving)] -
+                 PIECE_VALUES[uint8_t(Piece::WhitePawn)];
+  }
+
+  // Balance if the opponent does not recapture
+  int swap = PIECE_VALUES[uint8_t(captured)] - threshold;
+  if (swap < 0) {
+    return false;
+  }
+
+  // Balance if the opponent takes the moved piece for nothing
+  swap = PIECE_VALUES[uint8_t(moving)] - swap;
+  if (swap <= 0) {
+    return true;
+  }
+
+  uint64_t pawns = board.getPieceBitboard(Piece::WhitePawn) |
+                   board.getPieceBitboard(Piece::BlackPawn);
+  uint64_t knights = board.getPieceBitboard(Piece::WhiteKnight) |
+                     board.getPieceBitboard(Piece::BlackKnight);
+  uint64_t queens = board.getPieceBitboard(Piece::WhiteQueen) |
+                    board.getPieceBitboard(Piece::BlackQueen);
+  uint64_t bishops = board.getPieceBitboard(Piece::WhiteBishop) |
+                     board.getPieceBitboard(Piece::BlackBishop) | queens;
+  uint64_t rooks = board.getPieceBitboard(Piece::WhiteRook) |
+                   board.getPieceBitboard(Piece::BlackRook) | queens;
+
+  occupied ^= (1ULL << from) | (1ULL << to);
+  uint64_t attackers = board.attackersTo(to, occupied);
+  bool stmWhite = white;
+  bool result = true; // true while the side that moved is ahead
+
+  while (true) {
+    stmWhite = !stmWhite;
+    attackers &= occupied;
+
+    uint64_t stmPieces =
+        stmWhite ? board.getWhitePieces() : board.getBlackPieces();
+    uint64_t stmAttackers = attackers & stmPieces;
+    if (!stmAttackers) {
+      break;
+    }
+    result = !result;
+
+    // Recapture with the least valuable piece; removing it may uncover a
+    // slider behind it on the same line
+    uint64_t piece;
+    int value;
+    if ((piece = stmAttackers & pawns)) {
+      value = PIECE_VALUES[uint8_t(Piece::WhitePawn)];
+    } else if ((piece = stmAttackers & knights)) {
+      value = PIECE_VALUES[uint8_t(Piece::WhiteKnight)];
+    } else if ((piece = stmAttackers & bishops & ~queens)) {
+      value = PIECE_VALUES[uint8_t(Piece::WhiteBishop)];
+    } else if ((piece = stmAttackers & rooks & ~queens)) {
+      value = PIECE_VALUES[uint8_t(Piece::WhiteRook)];
+    } else if ((piece = stmAttackers & queens)) {
+      value = PIECE_VALUES[uint8_t(Piece::WhiteQueen)];
+    } else {
+      // Only the king is left: it may take only if nothing can take back
+      return (attackers & ~stmPieces) ? !result : result;
+    }
+
+    swap = value - swap;
+    if (swap < (result ? 1 : 0)) {
+      break;
+    }
+
+    occupied ^= piece & -piece;
+    if (value != PIECE_VALUES[uint8_t(Piece::WhiteKnight)]) {
+      attackers |= (getBishopAttacks(to, occupied) & bishops) |
+                   (getRookAttacks(to, occupied) & rooks);
+    }
+  }
+
+  return result;
+}
@@ -0,0 +1,21 @@
+#ifndef SEE_H
+#define SEE_H
+
+#include "../chess_board/chess_board.h"
+
+/**
+ * Static exchange evaluation: plays out all captures on the destination
+ * square of a move, each side always recapturing with its least valuable
+ * piece and free to stop when recapturing would lose material.
+ *
+ * Attackers hidden behind others on the same line (x-rays) join in as the
+ * pieces in front of them are used up. Pins are ignored.
+ *
+ * @param board Position before the move
+ * @param move Move to evaluate, usually a capture
+ * @param threshold Material gain to test against, in centipawns
+ * @return true if the side to move gains at least threshold
+ */
+bool seeGreaterOrEqual(const ChessBoard &board, Move move, int threshold);
+
+#endif
@@ -0,0 +1,126 @@
+#include "thread_pool.h"
+#include <algorithm>
+
+ThreadPool::ThreadPool(TranspositionTable &tt, int threads)
+    : tt(tt), stopped(false), bestMove(Move::none()) {
+  setThreads(threads);
+}
+
+ThreadPool::~ThreadPool() {
+  stop();
+  wait();
+  stopWorkers();
+}
+
+void ThreadPool::setThreads(int count) {
+  wait();
+  stopWorkers();
+
+  count = std::max(count, 1);
+  searches.clear();
+  for (int i = 0; i < count; i++) {
+    searches.push_back(std::make_unique<Search>(tt, i, &stopped));
+    searches.back()->setNetwork(network);
+  }
+  // The main thread enforces the node limit for the whole pool
+  searches[0]->countNodes = [this] { return getNodes(); };
+
+  for (int i = 0; i < count; i++) {
+    threads.emplace_back(&ThreadPool::workerLoop, this, i, searchId);
+  }
+}
+
+void ThreadPool::stopWorkers() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    exiting = true;
+  }
+  wake.notify_all();
+
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+  threads.clear();
+  exiting = false;
+}
+
+void ThreadPool::workerLoop(size_t index, uint64_t seenId) {
+  while (true) {
+    SearchLimits searchLimits;
+    std::function<void(Move)> onDone;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      wake.wait(lock, [&] { return exiting || searchId != seenId; });
+      if (exiting) {
+        return;
+      }
+      seenId = searchId;
+      searchLimits = limits;
+      onDone = finished;
+    }
+
+    Move move = searches[index]->think(boards[index], histories[index],
+                                       searchLimits);
+    if (index == 0) {
+      bestMove = move;
+      stopped = true;
+      if (onDone) {
+        onDone(move);
+      }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (--running == 0) {
+      idle.notify_all();
+    }
+  }
+}
+
+void ThreadPool::setNetwork(const Network *newNetwork) {
+  wait();
+
+  network = newNetwork;
+  for (auto &search : searches) {
+    search->setNetwork(network);
+  }
+}
+
+void ThreadPool::start(const ChessBoard &board, const BoardHistory &game,
+                       const SearchLimits &limits) {
+  wait();
+
+  // Reset before any thread runs so an early stop() is never overwritten
+  stopped = false;
+  tt.newSearch();
+  bestMove = Move::none();
+  searches[0]->onIteration = onIteration;
+
+  // Copies are made up front: the caller may change its board as soon as
+  // this returns
+  boards.assign(searches.size(), board);
+  histories.assign(searches.size(), game);
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    this->limits = limits;
+    finished = onFinish;
+    running = searches.size();
+    searchId++;
+  }
+  wake.notify_all();
+}
+
+Move ThreadPool::wait() {
+  std::unique_lock<std::mutex> lock(mutex);
+  idle.wait(lock, [this] { return running == 0; });
+
+  return bestMove;
+}
+
+uint64_t ThreadPool::getNodes() const {
+  uint64_t nodes = 0;
+  for (const auto &search : searches) {
+    nodes += search->getNodes();
+  }
+  return nodes;
+}
@@ -0,0 +1,142 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include "../chess_board/chess_board.h"
+#include "../search/search.h"
+#include "../transposition_table/transposition_table.h"
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Runs one search on several threads, Lazy SMP style.
+ *
+ * Every thread searches the same root on its own copy of the board with its
+ * own killer and history tables. The threads only communicate through the
+ * shared transposition table, and helpers skip some depths so they spread
+ * over the tree. Thread 0 is the main thread: it manages time, reports
+ * progress and decides the move. When it finishes, all helpers are stopped.
+ *
+ * The threads live as long as the pool: between searches they sleep on a
+ * condition variable, so starting a search does not create any threads.
+ */
+class ThreadPool {
+public:
+  /**
+   * @param tt Transposition table shared by all threads
+   * @param threads Number of search threads (at least 1)
+   */
+  explicit ThreadPool(TranspositionTable &tt, int threads = 1);
+
+  /**
+   * Stops any running search and joins the threads.
+   */
+  ~ThreadPool();
+
+  /**
+   * Changes the number of search threads. Waits for a running search.
+   * @param threads Number of search threads (at least 1)
+   */
+  void setThreads(int threads);
+
+  int size() const { return searches.size(); }
+
+  /**
+   * Evaluates with a network in all threads from the next search on.
+   * Waits for a running search.
+   *
+   * @param network Loaded network, or nullptr for the classical evaluation
+   */
+  void setNetwork(const Network *network);
+
+  /**
+   * Starts searching in the background and returns immediately.
+   *
+   * @param board Position to search; copied for each thread
+   * @param game Moves that led to the position; copied for each thread
+   * @param limits Limits enforced by the main thread
+   */
+  void start(const ChessBoard &board, const BoardHistory &game,
+             const SearchLimits &limits);
+
+  void start(const ChessBoard &board, const SearchLimits &limits) {
+    start(board, BoardHistory(), limits);
+  }
+
+  /**
+   * Asks all threads to stop. Thread-safe, does not wait.
+   */
+  void stop() { stopped = true; }
+
+  /**
+   * Waits until all threads have finished the search.
+   * @return Best move of the main thread
+   */
+  Move wait();
+
+  /**
+   * Searches and blocks until done.
+   * @return Best move of the main thread
+   */
+  Move think(const ChessBoard &board, const BoardHistory &game,
+             const SearchLimits &limits) {
+    start(board, game, limits);
+    return wait();
+  }
+
+  Move think(const ChessBoard &board, const SearchLimits &limits) {
+    start(board, limits);
+    return wait();
+  }
+
+  /**
+   * Gets the nodes visited by all threads in the current or last search.
+   */
+  uint64_t getNodes() const;
+
+  /// Called by the main thread after each completed iteration
+  std::function<void(const SearchInfo &)> onIteration;
+
+  /// Called by the main thread with its best move when the search is over
+  std::function<void(Move)> onFinish;
+
+private:
+  /**
+   * Body of a search thread: sleeps until a search starts, runs it and
+   * reports back, until the pool shuts the threads down.
+   *
+   * @param index Index of the thread's search
+   * @param seenId Last search the thread must not run again
+   */
+  void workerLoop(size_t index, uint64_t seenId);
+
+  /**
+   * Shuts down and joins all threads. The pool must be idle.
+   */
+  void stopWorkers();
+
+  TranspositionTable &tt;
+  std::atomic<bool> stopped;
+  std::vector<std::unique_ptr<Search>> searches;
+  std::vector<ChessBoard> boards;
+  std::vector<BoardHistory> histories;
+  const Network *network = nullptr;
+  std::vector<std::thread> threads;
+  Move bestMove;
+
+  // Guards the fields below, which hand searches to the threads
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::condition_variable idle;
+  uint64_t searchId = 0;
+  int running = 0;
+  bool exiting = false;
+  SearchLimits limits;
+  std::function<void(Move)> finished;
+};
+
+#endif
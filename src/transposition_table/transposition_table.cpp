@@ -0,0 +1,190 @@
+#include "transposition_table.h"
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+// Payload layout (64 bits):
+// bits 0-15 move, 16-31 score, 32-47 eval, 48-55 depth, 56-57 bound,
+// 58-63 generation
+static uint64_t packData(Move move, int score, int eval, int depth,
+                         Bound bound, uint8_t generation) {
+  return (uint64_t)move.data | (uint64_t)(uint16_t)score << 16 |
+         (uint64_t)(uint16_t)eval << 32 | (uint64_t)(uint8_t)depth << 48 |
+         (uint64_t)bound << 56 | (uint64_t)generation << 58;
+}
+
+static TTEntry unpackData(uint64_t data) {
+  TTEntry entry;
+  entry.move.data = (uint16_t)data;
+  entry.score = (int16_t)(data >> 16);
+  entry.eval = (int16_t)(data >> 32);
+  entry.depth = (int8_t)(data >> 48);
+  entry.bound = Bound((data >> 56) & 3);
+  return entry;
+}
+
+static uint8_t dataGeneration(uint64_t data) { return data >> 58; }
+
+static int dataDepth(uint64_t data) { return (int8_t)(data >> 48); }
+
+static Bound dataBound(uint64_t data) { return Bound((data >> 56) & 3); }
+
+TranspositionTable::TranspositionTable()
+    : clusters(nullptr), clusterCount(0), megabytes(0), generation(0) {
+  resize(16);
+}
+
+TranspositionTable::~TranspositionTable() { release(); }
+
+void TranspositionTable::release() {
+  std::free(clusters);
+  clusters = nullptr;
+  clusterCount = 0;
+}
+
+bool TranspositionTable::resize(size_t mb, int threads, bool hugePages) {
+  size_t bytes = mb * 1024 * 1024;
+  if (bytes < sizeof(Cluster)) {
+    bytes = sizeof(Cluster);
+  }
+
+  // Transparent huge pages need 2 MB alignment to back the table
+  const size_t HUGE_PAGE = 2 * 1024 * 1024;
+  size_t alignment = hugePages && bytes >= HUGE_PAGE ? HUGE_PAGE : 64;
+  size_t allocSize = (bytes + alignment - 1) / alignment * alignment;
+
+  // The old table is only freed once the new one exists, so a failed
+  // resize leaves it in use
+  Cluster *allocated =
+      static_cast<Cluster *>(std::aligned_alloc(alignment, allocSize));
+  if (!allocated) {
+    return false;
+  }
+
+#ifdef __linux__
+  if (alignment == HUGE_PAGE) {
+    madvise(allocated, allocSize, MADV_HUGEPAGE);
+  }
+#endif
+
+  release();
+  clusters = allocated;
+  clusterCount = bytes / sizeof(Cluster);
+  megabytes = mb;
+  clear(threads);
+  return true;
+}
+
+void TranspositionTable::clear(int threads) {
+  generation = 0;
+  if (!clusters) {
+    return;
+  }
+
+  if (threads < 1) {
+    threads = 1;
+  }
+
+  // Each thread zeroes its own contiguous stripe; on NUMA systems this also
+  // spreads first-touch page placement across the nodes doing the work
+  size_t stride = (clusterCount + threads - 1) / threads;
+  auto clearStripe = [this, stride](int index) {
+    size_t begin = index * stride;
+    size_t end = std::min(begin + stride, clusterCount);
+    if (begin < end) {
+      std::memset(static_cast<void *>(clusters + begin), 0,
+                  (end - begin) * sizeof(Cluster));
+    }
+  };
+
+  std::vector<std::thread> workers;
+  for (int i = 1; i < threads; i++) {
+    workers.emplace_back(clearStripe, i);
+  }
+  clearStripe(0);
+  for (std::thread &worker : workers) {
+    worker.join();
+  }
+}
+
+void TranspositionTable::newSearch() { generation = (generation + 1) & 63; }
+
+bool TranspositionTable::probe(uint64_t key, TTEntry &entry) const {
+  if (!clusters) {
+    return false;
+  }
+
+  const Cluster &cluster = clusters[clusterIndex(key)];
+
+  for (const Slot &slot : cluster.slots) {
+    uint64_t data = slot.data.load(std::memory_order_relaxed);
+    uint64_t check = slot.keyXorData.load(std::memory_order_relaxed);
+    if ((check ^ data) == key && dataBound(data) != Bound::None) {
+      entry = unpackData(data);
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void TranspositionTable::store(uint64_t key, Move move, int score, int eval,
+                               int depth, Bound bound) {
+  if (!clusters) {
+    return;
+  }
+
+  Cluster &cluster = clusters[clusterIndex(key)];
+
+  Slot *replace = &cluster.slots[0];
+  int replaceValue = 1 << 30;
+
+  for (Slot &slot : cluster.slots) {
+    uint64_t data = slot.data.load(std::memory_order_relaxed);
+    uint64_t check = slot.keyXorData.load(std::memory_order_relaxed);
+
+    if ((check ^ data) == key || dataBound(data) == Bound::None) {
+      // Same position: keep its move if this search did not find one
+      if ((check ^ data) == key && move == Move::none()) {
+        move.data = (uint16_t)data;
+      }
+      replace = &slot;
+      break;
+    }
+
+    // Each generation of age counts as much as 8 plies of depth
+    int age = (64 + generation - dataGeneration(data)) & 63;
+    int value = dataDepth(data) - 8 * age;
+    if (value < replaceValue) {
+      replaceValue = value;
+      replace = &slot;
+    }
+  }
+
+  uint64_t data = packData(move, score, eval, depth, bound, generation);
+  replace->keyXorData.store(key ^ data, std::memory_order_relaxed);
+  replace->data.store(data, std::memory_order_relaxed);
+}
+
+int TranspositionTable::hashfull() const {
+  size_t samples = std::min<size_t>(1000, clusterCount);
+  if (samples == 0) {
+    return 0;
+  }
+
+  int used = 0;
+  for (size_t i = 0; i < samples; i++) {
+    for (const Slot &slot : clusters[i].slots) {
+      uint64_t data = slot.data.load(std::memory_order_relaxed);
+      used += dataBound(data) != Bound::None &&
+              dataGeneration(data) == generation;
+    }
+  }
+
+  return used * 1000 / (samples * CLUSTER_SIZE);
+}
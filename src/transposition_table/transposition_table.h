@@ -0,0 +1,141 @@
+#ifndef TRANSPOSITION_TABLE_H
+#define TRANSPOSITION_TABLE_H
+
+#include "../chess_board/chess_board.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * How a stored score relates to the true score of the position.
+ */
+enum class Bound : uint8_t {
+  None = 0,
+  Upper = 1, /// Failed low: true score <= stored score
+  Lower = 2, /// Failed high: true score >= stored score
+  Exact = 3
+};
+
+/**
+ * Unpacked contents of a transposition table entry.
+ */
+struct TTEntry {
+  Move move;
+  int16_t score;
+  int16_t eval;
+  int8_t depth;
+  Bound bound;
+};
+
+/**
+ * Shared hash table of search results, safe to use from many threads
+ * without locks.
+ *
+ * Layout: 64-byte clusters, each aligned to a cache line and holding four
+ * 16-byte slots, so a probe touches exactly one cache line. A slot stores
+ * its payload next to (key XOR payload); a torn write from two racing
+ * threads then fails the key check instead of returning mixed data.
+ *
+ * Replacement keeps whichever slot is worth least: shallow entries and
+ * entries left over from earlier searches go first.
+ */
+class TranspositionTable {
+public:
+  TranspositionTable();
+  ~TranspositionTable();
+
+  TranspositionTable(const TranspositionTable &) = delete;
+  TranspositionTable &operator=(const TranspositionTable &) = delete;
+
+  /**
+   * Reallocates the table and clears it. If the memory cannot be
+   * allocated, the current table is kept as it is.
+   *
+   * @param megabytes Table size in MB
+   * @param threads Number of threads used to clear it
+   * @param hugePages Ask the kernel for 2 MB pages (Linux only)
+   * @return true if the memory could be allocated
+   */
+  bool resize(size_t megabytes, int threads = 1, bool hugePages = true);
+
+  /**
+   * Empties every slot, splitting the work across threads.
+   *
+   * @param threads Number of threads to use
+   */
+  void clear(int threads = 1);
+
+  /**
+   * Starts a new search generation so older entries age out first.
+   */
+  void newSearch();
+
+  /**
+   * Looks up a position.
+   *
+   * @param key Zobrist key of the position
+   * @param entry Filled with the stored data on a hit
+   * @return true if the position was found
+   */
+  bool probe(uint64_t key, TTEntry &entry) const;
+
+  /**
+   * Stores a search result, replacing the least valuable slot.
+   *
+   * @param key Zobrist key of the position
+   * @param move Best move found, or Move::none()
+   * @param score Search score, already adjusted for mate distance
+   * @param eval Static evaluation of the position
+   * @param depth Remaining depth the score was searched to
+   * @param bound How the score bounds the true value
+   */
+  void store(uint64_t key, Move move, int score, int eval, int depth,
+             Bound bound);
+
+  /**
+   * Hints the CPU to start loading the cluster for a key.
+   */
+  void prefetch(uint64_t key) const {
+    if (clusters) {
+      __builtin_prefetch(&clusters[clusterIndex(key)]);
+    }
+  }
+
+  /**
+   * Estimates table usage by this search, in permille (for UCI hashfull).
+   */
+  int hashfull() const;
+
+  /**
+   * Gets the table size in MB.
+   */
+  size_t sizeMegabytes() const { return megabytes; }
+
+private:
+  static const int CLUSTER_SIZE = 4;
+
+  struct Slot {
+    std::atomic<uint64_t> keyXorData;
+    std::atomic<uint64_t> data;
+  };
+
+  struct alignas(64) Cluster {
+    Slot slots[CLUSTER_SIZE];
+  };
+
+  static_assert(sizeof(Cluster) == 64, "Cluster must fill one cache line");
+
+  Cluster *clusters;
+  size_t clusterCount;
+  size_t megabytes;
+  uint8_t generation; /// 6-bit search counter stored in each slot
+
+  size_t clusterIndex(uint64_t key) const {
+    // maps the key uniformly onto [0, clusterCount) without a modulo
+    return (size_t)(((unsigned __int128)key * clusterCount) >> 64);
+  }
+
+  void release();
+};
+
+#endif
@@ -0,0 +1,231 @@
+#include "uci.h"
+#include <algorithm>
+#include <cstdlib>
+
+static const int DEFAULT_HASH = 16;   /// MB, as allocated by the table
+static const int MAX_HASH = 65536;    /// MB
+static const int MAX_THREADS = 256;
+
+/**
+ * Formats a move for UCI, which writes a missing move as 0000.
+ */
+static std::string uciMove(Move move) {
+  return move == Move::none() ? "0000" : moveToString(move);
+}
+
+Uci::Uci(std::istream &in, std::ostream &out)
+    : in(in), out(out), tt(), pool(tt) {
+  pool.onIteration = [this](const SearchInfo &info) { send(infoLine(info)); };
+  pool.onFinish = [this](Move move) { send("bestmove " + uciMove(move)); };
+}
+
+void Uci::loop() {
+  std::string line;
+  while (std::getline(in, line)) {
+    if (!execute(line)) {
+      pool.stop();
+      break;
+    }
+  }
+
+  // At the end of piped input let a limited search finish and report; an
+  // infinite one could never be stopped
+  if (infinite) {
+    pool.stop();
+  }
+  pool.wait();
+}
+
+bool Uci::execute(const std::string &line) {
+  std::istringstream args(line);
+  std::string command;
+  args >> command;
+
+  if (command == "uci") {
+    uci();
+  } else if (command == "isready") {
+    send("readyok");
+  } else if (command == "ucinewgame") {
+    pool.wait();
+    tt.clear(pool.size());
+  } else if (command == "setoption") {
+    setOption(args);
+  } else if (command == "position") {
+    position(args);
+  } else if (command == "go") {
+    go(args);
+  } else if (command == "stop") {
+    pool.stop();
+  } else if (command == "quit") {
+    return false;
+  } else if (!command.empty()) {
+    send("info string unknown command " + command);
+  }
+
+  return true;
+}
+
+void Uci::uci() {
+  send("id name chess-engine");
+  send("id author the chess-engine authors");
+  send("option name Hash type spin default " + std::to_string(DEFAULT_HASH) +
+       " min 1 max " + std::to_string(MAX_HASH));
+  send("option name Threads type spin default 1 min 1 max " +
+       std::to_string(MAX_THREADS));
+  send("option name EvalFile type string default <empty>");
+  send("uciok");
+}
+
+void Uci::setOption(std::istringstream &args) {
+  // setoption name <id> [value <x>], where both may contain spaces
+  std::string token, name, value;
+  args >> token;
+  while (args >> token && token != "value") {
+    name += (name.empty() ? "" : " ") + token;
+  }
+  while (args >> token) {
+    value += (value.empty() ? "" : " ") + token;
+  }
+
+  // The GUI only sends options between searches, but a stray one must not
+  // reallocate anything under the running threads
+  pool.wait();
+
+  if (name == "Hash") {
+    int megabytes = std::clamp(std::atoi(value.c_str()), 1, MAX_HASH);
+    // A failed resize keeps the current table, which stays in use
+    if (!tt.resize(megabytes, pool.size())) {
+      send("info string could not allocate " + std::to_string(megabytes) +
+           " MB of hash, keeping " + std::to_string(tt.sizeMegabytes()) +
+           " MB");
+    }
+  } else if (name == "Threads") {
+    pool.setThreads(std::clamp(std::atoi(value.c_str()), 1, MAX_THREADS));
+  } else if (name == "EvalFile") {
+    setEvalFile(value == "<empty>" ? "" : value);
+  } else {
+    send("info string unknown option " + name);
+  }
+}
+
+void Uci::setEvalFile(const std::string &path) {
+  // The searches keep a pointer to the network, so detach it before
+  // reloading
+  pool.setNetwork(nullptr);
+  if (path.empty()) {
+    return;
+  }
+
+  if (network.load(path)) {
+    pool.setNetwork(&network);
+    send("info string loaded network " + path);
+  } else {
+    send("info string could not load network " + path +
+         ", using the classical evaluation");
+  }
+}
+
+void Uci::position(std::istringstream &args) {
+  std::string token, fen;
+  args >> token;
+  if (token == "startpos") {
+    fen = STARTING_FEN;
+    args >> token;
+  } else if (token == "fen") {
+    while (args >> token && token != "moves") {
+      fen += token + " ";
+    }
+  } else {
+    return;
+  }
+
+  game.clear();
+  if (!board.loadFen(fen)) {
+    send("info string invalid fen " + fen);
+    board.loadFen(STARTING_FEN);
+    return;
+  }
+
+  // token is "moves" here if any follow
+  while (args >> token) {
+    Move move = parseMove(token);
+    if (move == Move::none()) {
+      send("info string illegal move " + token);
+      return;
+    }
+    game.makeMove(board, move);
+  }
+}
+
+Move Uci::parseMove(const std::string &text) const {
+  MoveList moves;
+  board.generateMoves(moves);
+  for (int i = 0; i < moves.size(); i++) {
+    if (moveToString(moves[i]) == text) {
+      return moves[i];
+    }
+  }
+  return Move::none();
+}
+
+void Uci::go(std::istringstream &args) {
+  SearchLimits limits;
+  std::string token;
+  while (args >> token) {
+    if (token == "wtime") {
+      args >> limits.time[0];
+    } else if (token == "btime") {
+      args >> limits.time[1];
+    } else if (token == "winc") {
+      args >> limits.increment[0];
+    } else if (token == "binc") {
+      args >> limits.increment[1];
+    } else if (token == "movestogo") {
+      args >> limits.movesToGo;
+    } else if (token == "movetime") {
+      args >> limits.moveTime;
+    } else if (token == "depth") {
+      args >> limits.depth;
+    } else if (token == "nodes") {
+      args >> limits.nodes;
+    } else if (token == "infinite") {
+      limits.infinite = true;
+    }
+  }
+
+  infinite = limits.infinite;
+
+  // Returns at once; the main search thread sends bestmove when it is done
+  pool.start(board, game, limits);
+}
+
+std::string Uci::infoLine(const SearchInfo &info) const {
+  // Node counts of all threads, not just the main one reporting
+  uint64_t nodes = pool.getNodes();
+  uint64_t nps = info.time > 0 ? nodes * 1000 / info.time : nodes;
+
+  std::string score;
+  if (info.score >= MATE_BOUND) {
+    score = "mate " + std::to_string((MATE_SCORE - info.score + 1) / 2);
+  } else if (info.score <= -MATE_BOUND) {
+    score = "mate " + std::to_string(-(MATE_SCORE + info.score) / 2);
+  } else {
+    score = "cp " + std::to_string(info.score);
+  }
+
+  std::string line = "info depth " + std::to_string(info.depth) +
+                     " seldepth " + std::to_string(info.selDepth) +
+                     " score " + score + " nodes " + std::to_string(nodes) +
+                     " nps " + std::to_string(nps) + " hashfull " +
+                     std::to_string(tt.hashfull()) + " time " +
+                     std::to_string(info.time) + " pv";
+  for (Move move : info.pv) {
+    line += " " + moveToString(move);
+  }
+  return line;
+}
+
+void Uci::send(const std::string &line) {
+  std::lock_guard<std::mutex> lock(outputMutex);
+  out << line << std::endl;
+}
@@ -0,0 +1,91 @@
+#ifndef UCI_H
+#define UCI_H
+
+#include "../chess_board/chess_board.h"
+#include "../nnue/nnue.h"
+#include "../search/search.h"
+#include "../thread_pool/thread_pool.h"
+#include "../transposition_table/transposition_table.h"
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+
+/**
+ * Universal Chess Interface front-end.
+ *
+ * Commands are read on the calling thread, while searches run on the
+ * thread pool, so stop and isready are handled at once even in the middle
+ * of a search. The main search thread prints its own info lines and the
+ * bestmove when it is done; all output goes through one lock so lines from
+ * different threads never interleave.
+ *
+ * Supported commands: uci, isready, ucinewgame, setoption (Hash, Threads,
+ * EvalFile), position, go, stop and quit.
+ */
+class Uci {
+public:
+  /**
+   * @param in Stream to read commands from
+   * @param out Stream to write responses to
+   */
+  explicit Uci(std::istream &in = std::cin, std::ostream &out = std::cout);
+
+  /**
+   * Reads and executes commands until quit or the end of the input. quit
+   * stops the running search; at the end of the input it may finish.
+   */
+  void loop();
+
+  /**
+   * Executes one command line.
+   *
+   * @param line Command with its arguments
+   * @return false if the command was quit
+   */
+  bool execute(const std::string &line);
+
+private:
+  std::istream &in;
+  std::ostream &out;
+  std::mutex outputMutex; /// Used by the search threads, so declared first
+
+  ChessBoard board;
+  BoardHistory game; /// Moves of the position command, for repetitions
+  Network network;
+  TranspositionTable tt;
+  ThreadPool pool;
+  bool infinite = false; /// The last go had no limits
+
+  void uci();
+  void setOption(std::istringstream &args);
+  void position(std::istringstream &args);
+  void go(std::istringstream &args);
+
+  /**
+   * Loads the network named by the EvalFile option, or detaches it.
+   *
+   * @param path Weight file, or empty to use the classical evaluation
+   */
+  void setEvalFile(const std::string &path);
+
+  /**
+   * Finds the legal move written in long algebraic notation (e2e4, e7e8q).
+   *
+   * @param text Move to parse
+   * @return Matching legal move, or Move::none()
+   */
+  Move parseMove(const std::string &text) const;
+
+  /**
+   * Writes one line and flushes it. Thread-safe.
+   */
+  void send(const std::string &line);
+
+  /**
+   * Formats an iteration report as an info line.
+   */
+  std::string infoLine(const SearchInfo &info) const;
+};
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef ZOBRIST_H
+#define ZOBRIST_H
+
+#include <cstdint>
+
+/**
+ * Random keys for Zobrist hashing, generated at compile time.
+ *
+ * A position key is the XOR of the keys of every piece on its square, the
+ * side to move (when black), the castling rights and the en passant file.
+ * The castling key of a rights mask (see CastlingRight) is the XOR of one
+ * key per right it holds, so changing rights costs a single lookup.
+ */
+struct ZobristKeys {
+  uint64_t pieces[15][64]; /// Indexed by Piece value, then square
+  uint64_t castling[16];   /// Indexed by castling rights mask
+  uint64_t enPassantFile[8];
+  uint64_t blackToMove;
+};
+
+/**
+ * SplitMix64 step, a fast generator with well distributed 64-bit output.
+ */
+constexpr uint64_t splitMix64(uint64_t &state) {
+  uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+constexpr ZobristKeys generateZobristKeys() {
+  ZobristKeys keys{};
+  uint64_t state = 0x2D358DCCAA6C78A5ULL;
+
+  for (int piece = 0; piece < 15; piece++) {
+    for (int square = 0; square < 64; square++) {
+      keys.pieces[piece][square] = splitMix64(state);
+    }
+  }
+  for (int i = 0; i < 4; i++) {
+    uint64_t right = splitMix64(state);
+    for (int mask = 0; mask < 16; mask++) {
+      if (mask & (1 << i)) {
+        keys.castling[mask] ^= right;
+      }
+    }
+  }
+  for (int file = 0; file < 8; file++) {
+    keys.enPassantFile[file] = splitMix64(state);
+  }
+  keys.blackToMove = splitMix64(state);
+
+  return keys;
+}
+
+inline constexpr ZobristKeys ZOBRIST = generateZobristKeys();
+
+#endif
@@ -0,0 +1,7 @@
+#include "./src/uci/uci.h"
+
+int main() {
+  Uci uci;
+  uci.loop();
+  return 0;
+}